@@ -0,0 +1,60 @@
+#pragma once
+// Replaces the global allocation functions to count heap allocations.
+// Include from exactly one translation unit of a benchmark binary.
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "benchmark/benchmark.h"
+
+namespace bench {
+
+inline std::atomic<uint64_t> &allocCount() {
+  static std::atomic<uint64_t> count{0};
+  return count;
+}
+
+inline uint64_t &threadAllocCount() {
+  static thread_local uint64_t count = 0;
+  return count;
+}
+
+// Reports the allocations made while the benchmark loop ran as allocs/op.
+// With this_thread set only the calling thread's count, e.g. to leave out
+// a server running in the same process.
+class AllocCounter {
+ public:
+  explicit AllocCounter(benchmark::State &state, bool this_thread = false)
+      : state_(state), this_thread_(this_thread), start_(count()) {}
+
+  ~AllocCounter() {
+    state_.counters["allocs/op"] =
+        benchmark::Counter(static_cast<double>(count() - start_),
+                           benchmark::Counter::kAvgIterations);
+  }
+
+ private:
+  benchmark::State &state_;
+  const bool this_thread_;
+  uint64_t start_;
+
+  uint64_t count() const {
+    return this_thread_ ? threadAllocCount()
+                        : allocCount().load(std::memory_order_relaxed);
+  }
+};
+
+}  // namespace bench
+
+void *operator new(std::size_t size) {
+  bench::allocCount().fetch_add(1, std::memory_order_relaxed);
+  ++bench::threadAllocCount();
+  if (auto ptr = std::malloc(size ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
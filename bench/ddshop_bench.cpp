@@ -0,0 +1,168 @@
+// Times the parsing and request building steps of the session calls on
+// recorded payloads: carts of 3, 12 and 100 items and 1, 20 and 100
+// reserve time slots. Every benchmark reports allocs/op next to ns/op.
+#include <fstream>
+#include <iterator>
+
+#include "alloc_counter.hpp"
+#include "sax_extract.hpp"
+#include "session_impl.hpp"
+#include "spdlog/spdlog.h"
+#include "uuid.h"
+
+namespace {
+
+std::string loadFixture(const std::string &name) {
+  std::ifstream fin(std::string(DDSHOP_FIXTURE_DIR) + "/" + name);
+  if (!fin.good()) {
+    throw std::runtime_error("Missing fixture " + name);
+  }
+  return std::string((std::istreambuf_iterator<char>(fin)),
+                     std::istreambuf_iterator<char>());
+}
+
+std::string cartFixture(int64_t items) {
+  return loadFixture("cart_" + std::to_string(items) + ".json");
+}
+
+ddshop::SessionImpl &session() {
+  static ddshop::SessionImpl *instance = []() {
+    spdlog::set_level(spdlog::level::off);
+    ddshop::SessionConfig config;
+    config.cookie = "bench";
+    auto session = new ddshop::SessionImpl(config);
+    ddshop::Address address;
+    address.id = "5e8b2c1fa0b1c2d3e4f56789";
+    address.city_number = "0101";
+    address.longitude = 121.473701;
+    address.latitude = 31.230416;
+    address.station_id = "5b8a1f56c0a1ea3d458b456b";
+    session->setAddress(address);
+    return session;
+  }();
+  return *instance;
+}
+
+std::shared_ptr<ddshop::Cart> loadCart(int64_t items) {
+  auto cart = std::make_shared<ddshop::Cart>();
+  nlohmann::json ret_json;
+  if (!ddshop::SessionImpl::ensureBasicResp(cartFixture(items), ret_json) ||
+      !ddshop::SessionImpl::parseCart(ret_json["data"], *cart)) {
+    throw std::runtime_error("Invalid cart fixture");
+  }
+  return cart;
+}
+
+const std::pair<uint64_t, uint64_t> RESERVE_TIME{1650067200, 1650069000};
+
+// An order as checkOrder leaves it for doOrder.
+ddshop::Order checkedOrder(int64_t items) {
+  auto snapshot = std::make_shared<ddshop::CartSnapshot>();
+  snapshot->cart = loadCart(items);
+  snapshot->reserve_time.push_back(RESERVE_TIME);
+  ddshop::Order order;
+  order.snapshot = snapshot;
+  order.reserve_time = RESERVE_TIME;
+  nlohmann::json ret_json;
+  ddshop::SessionImpl::ensureBasicResp(loadFixture("check_order.json"),
+                                       ret_json);
+  session().checkOrderData(ret_json["data"], *snapshot->cart, RESERVE_TIME,
+                           order.check_order_data);
+  return order;
+}
+
+void BM_EnsureBasicResp(benchmark::State &state) {
+  auto body = cartFixture(state.range(0));
+  nlohmann::json ret_json;
+  bench::AllocCounter allocs(state);
+  for (auto _ : state) {
+    if (!ddshop::SessionImpl::ensureBasicResp(body, ret_json)) {
+      state.SkipWithError("Invalid response");
+    }
+    benchmark::DoNotOptimize(ret_json);
+  }
+  state.SetBytesProcessed(state.iterations() * body.size());
+}
+
+void BM_ParseCart(benchmark::State &state) {
+  nlohmann::json ret_json;
+  ddshop::SessionImpl::ensureBasicResp(cartFixture(state.range(0)), ret_json);
+  const auto &data = ret_json["data"];
+  bench::AllocCounter allocs(state);
+  for (auto _ : state) {
+    ddshop::Cart cart;
+    if (!ddshop::SessionImpl::parseCart(data, cart)) {
+      state.SkipWithError("No cart");
+    }
+    benchmark::DoNotOptimize(cart.packages_head.data());
+  }
+}
+
+void BM_ExtractReserveTimes(benchmark::State &state) {
+  auto body =
+      loadFixture("reserve_time_" + std::to_string(state.range(0)) + ".json");
+  // Reused across iterations as refreshReserveTime reuses it across polls.
+  std::vector<std::pair<uint64_t, uint64_t>> out;
+  bench::AllocCounter allocs(state);
+  for (auto _ : state) {
+    ddshop::BasicResp resp;
+    bool has_time = false;
+    if (!ddshop::extractReserveTimes(body, resp, has_time, out) ||
+        !has_time) {
+      state.SkipWithError("No reserve time");
+    }
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * body.size());
+}
+
+void BM_CheckOrderBody(benchmark::State &state) {
+  auto cart = loadCart(state.range(0));
+  auto &impl = session();
+  bench::AllocCounter allocs(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(impl.checkOrderBody(*cart, RESERVE_TIME).data());
+  }
+}
+
+void BM_CheckOrderData(benchmark::State &state) {
+  auto cart = loadCart(12);
+  nlohmann::json ret_json;
+  ddshop::SessionImpl::ensureBasicResp(loadFixture("check_order.json"),
+                                       ret_json);
+  auto &impl = session();
+  nlohmann::json out;
+  bench::AllocCounter allocs(state);
+  for (auto _ : state) {
+    impl.checkOrderData(ret_json["data"], *cart, RESERVE_TIME, out);
+    benchmark::DoNotOptimize(out);
+  }
+}
+
+void BM_DoOrderBody(benchmark::State &state) {
+  auto order = checkedOrder(state.range(0));
+  auto &impl = session();
+  bench::AllocCounter allocs(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(impl.doOrderBody(order).data());
+  }
+}
+
+void BM_UuidString(benchmark::State &state) {
+  bench::AllocCounter allocs(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(uuid::v4::UUID::New().String());
+  }
+}
+
+}  // namespace
+
+BENCHMARK(BM_EnsureBasicResp)->Arg(3)->Arg(12)->Arg(100);
+BENCHMARK(BM_ParseCart)->Arg(3)->Arg(12)->Arg(100);
+BENCHMARK(BM_ExtractReserveTimes)->Arg(1)->Arg(20)->Arg(100);
+BENCHMARK(BM_CheckOrderBody)->Arg(3)->Arg(12)->Arg(100);
+BENCHMARK(BM_CheckOrderData);
+BENCHMARK(BM_DoOrderBody)->Arg(3)->Arg(12)->Arg(100);
+BENCHMARK(BM_UuidString);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,133 @@
+// Drives the full dispatcher (cart -> reserve time -> checkOrder -> doOrder)
+// against the local mock and measures, per trial, the time from a slot
+// being offered server side to addNewOrder for that slot arriving.
+//
+// Usage: e2e_latency [trials] [script.json]
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <random>
+
+#include "ddshop/dispatcher.hpp"
+#include "ddshop/session.hpp"
+#include "mock_ddxq.hpp"
+#include "spdlog/spdlog.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const uint64_t FIRST_SLOT = 1650067200;
+const uint64_t SLOT_LENGTH = 1800;
+const std::chrono::seconds TRIAL_TIMEOUT(10);
+
+double percentile(const std::vector<double> &sorted, double p) {
+  auto idx = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  size_t trials = argc > 1 ? std::stoul(argv[1]) : 50;
+  mock::Script script;
+  if (argc > 2) {
+    std::ifstream fin(argv[2]);
+    auto json = nlohmann::json::parse(fin, nullptr, false);
+    if (json.is_discarded() || !mock::Script::fromJson(json, script)) {
+      fprintf(stderr, "Invalid script %s\n", argv[2]);
+      return 1;
+    }
+    // Slots are offered by the benchmark itself.
+    script.slots.clear();
+  }
+  spdlog::set_level(spdlog::level::err);
+
+  mock::DdxqMock server(std::move(script));
+  if (server.start() < 0) {
+    return 1;
+  }
+
+  // The slot is withdrawn as soon as its order arrives, so the order fails
+  // with 5004 and the dispatcher keeps its cart for the next trial.
+  std::mutex mutex;
+  std::condition_variable cv;
+  uint64_t expected = 0;
+  Clock::time_point submitted;
+  server.onSubmit([&](uint64_t reserved_time) {
+    auto now = Clock::now();
+    std::lock_guard<std::mutex> lck(mutex);
+    if (reserved_time == expected && expected) {
+      submitted = now;
+      expected = 0;
+      server.closeSlots();
+      cv.notify_all();
+    }
+  });
+
+  ddshop::SessionConfig config;
+  config.cookie = "mock";
+  config.base_url = server.baseUrl();
+  auto dispatcher = ddshop::Dispatcher::makeDispatcher();
+  if (!dispatcher->initSession(config)) {
+    fprintf(stderr, "Failed to init session against the mock\n");
+    return 1;
+  }
+  std::vector<ddshop::Address> addresses;
+  dispatcher->getSession()->getAddresses(addresses);
+  if (addresses.empty()) {
+    return 1;
+  }
+  dispatcher->getSession()->setAddress(addresses.front());
+  dispatcher->start();
+
+  std::mt19937 ra(std::random_device{}());
+  std::uniform_int_distribution<> idle_ms(300, 1500);
+  std::vector<double> latencies;
+  size_t missed = 0;
+  for (size_t i = 0; i < trials; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(idle_ms(ra)));
+    auto slot = FIRST_SLOT + i * SLOT_LENGTH;
+    std::unique_lock<std::mutex> lck(mutex);
+    expected = slot;
+    auto offered = Clock::now();
+    server.openSlot(slot, slot + SLOT_LENGTH);
+    if (cv.wait_for(lck, TRIAL_TIMEOUT, [&]() { return expected == 0; })) {
+      latencies.push_back(
+          std::chrono::duration<double, std::milli>(submitted - offered)
+              .count());
+    } else {
+      ++missed;
+      expected = 0;
+      server.closeSlots();
+    }
+    fprintf(stderr, "\rtrial %zu/%zu", i + 1, trials);
+  }
+  fprintf(stderr, "\n");
+  dispatcher->stop();
+  server.stop();
+
+  if (latencies.empty()) {
+    printf("no trial completed, %zu missed\n", missed);
+    return 1;
+  }
+  std::sort(latencies.begin(), latencies.end());
+  double sum = 0;
+  for (auto it : latencies) {
+    sum += it;
+  }
+  auto counters = server.counters();
+  printf("slot-to-submit latency over %zu trials (%zu missed), ms\n",
+         latencies.size(), missed);
+  printf("  p50 %8.2f\n  p90 %8.2f\n  p99 %8.2f\n  max %8.2f\n  mean %7.2f\n",
+         percentile(latencies, 0.5), percentile(latencies, 0.9),
+         percentile(latencies, 0.99), latencies.back(),
+         sum / latencies.size());
+  printf("server saw %llu requests, %llu checkOrder, %llu addNewOrder\n",
+         static_cast<unsigned long long>(counters.requests),
+         static_cast<unsigned long long>(counters.check_order),
+         static_cast<unsigned long long>(counters.add_new_order));
+  return 0;
+}
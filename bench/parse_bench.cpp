@@ -0,0 +1,94 @@
+// DOM parsing as refreshReserveTime and hasUnpaidOrder used to do it,
+// against the streaming extraction in sax_extract over recorded responses.
+#include <fstream>
+#include <iterator>
+
+#include "alloc_counter.hpp"
+#include "benchmark/benchmark.h"
+#include "nlohmann/json.hpp"
+#include "sax_extract.hpp"
+
+namespace {
+
+std::string loadFixture(const std::string &name) {
+  std::ifstream fin(std::string(DDSHOP_FIXTURE_DIR) + "/" + name);
+  if (!fin.good()) {
+    throw std::runtime_error("Missing fixture " + name);
+  }
+  return std::string((std::istreambuf_iterator<char>(fin)),
+                     std::istreambuf_iterator<char>());
+}
+
+std::string reserveTimeFixture(int64_t slots) {
+  return loadFixture("reserve_time_" + std::to_string(slots) + ".json");
+}
+
+void BM_ReserveTimeDom(benchmark::State &state) {
+  auto body = reserveTimeFixture(state.range(0));
+  std::vector<std::pair<uint64_t, uint64_t>> out;
+  bench::AllocCounter allocs(state);
+  for (auto _ : state) {
+    out.clear();
+    auto ret_json = nlohmann::json::parse(body, nullptr, false);
+    if (ret_json["data"].empty() || ret_json["data"][0]["time"].empty()) {
+      state.SkipWithError("No reserve time");
+    }
+    for (auto &it : ret_json["data"][0]["time"][0]["times"]) {
+      if (it["disableType"] != 0) {
+        continue;
+      }
+      out.emplace_back(it["start_timestamp"].get<uint64_t>(),
+                       it["end_timestamp"].get<uint64_t>());
+    }
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * body.size());
+}
+
+void BM_ReserveTimeSax(benchmark::State &state) {
+  auto body = reserveTimeFixture(state.range(0));
+  std::vector<std::pair<uint64_t, uint64_t>> out;
+  out.reserve(state.range(0));
+  bench::AllocCounter allocs(state);
+  for (auto _ : state) {
+    ddshop::BasicResp resp;
+    bool has_time = false;
+    if (!ddshop::extractReserveTimes(body, resp, has_time, out) ||
+        !has_time) {
+      state.SkipWithError("No reserve time");
+    }
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(state.iterations() * body.size());
+}
+
+void BM_NotPayListDom(benchmark::State &state) {
+  auto body = loadFixture("not_pay_list.json");
+  bench::AllocCounter allocs(state);
+  for (auto _ : state) {
+    auto ret_json = nlohmann::json::parse(body, nullptr, false);
+    benchmark::DoNotOptimize(ret_json["data"]["order_list"].size());
+  }
+  state.SetBytesProcessed(state.iterations() * body.size());
+}
+
+void BM_NotPayListSax(benchmark::State &state) {
+  auto body = loadFixture("not_pay_list.json");
+  bench::AllocCounter allocs(state);
+  for (auto _ : state) {
+    ddshop::BasicResp resp;
+    size_t count = 0;
+    ddshop::countOrderList(body, resp, count);
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetBytesProcessed(state.iterations() * body.size());
+}
+
+}  // namespace
+
+BENCHMARK(BM_ReserveTimeDom)->Arg(1)->Arg(20)->Arg(100);
+BENCHMARK(BM_ReserveTimeSax)->Arg(1)->Arg(20)->Arg(100);
+BENCHMARK(BM_NotPayListDom);
+BENCHMARK(BM_NotPayListSax);
+
+BENCHMARK_MAIN();
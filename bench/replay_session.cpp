@@ -0,0 +1,97 @@
+// Replays a recorded cassette through a session, calling the session
+// method behind each recorded request in the recorded order. Responses are
+// served in process and in a fixed order, so two runs only differ by the
+// code under test: the parsers, snapshot publication and request building.
+//
+// Usage: replay_session cassette [benchmark flags]
+#include "alloc_counter.hpp"
+#include "cassette.hpp"
+#include "ddshop/session.hpp"
+#include "spdlog/spdlog.h"
+
+namespace {
+
+void replay(ddshop::Session &session,
+            const std::vector<ddshop::CassetteEntry> &entries) {
+  std::vector<ddshop::Address> addresses;
+  ddshop::Order order;
+  int code = 0;
+  for (auto &it : entries) {
+    switch (it.endpoint) {
+      case ddshop::Endpoint::USER_DETAIL:
+        session.initUser();
+        break;
+      case ddshop::Endpoint::USER_ADDRESS:
+        session.getAddresses(addresses);
+        if (!addresses.empty()) {
+          session.setAddress(addresses.front());
+        }
+        break;
+      case ddshop::Endpoint::CART_CHECK_ALL:
+        session.cartCheckAll();
+        break;
+      case ddshop::Endpoint::CART_INDEX:
+        session.getCart();
+        break;
+      case ddshop::Endpoint::RESERVE_TIME:
+        session.refreshReserveTime();
+        break;
+      case ddshop::Endpoint::CHECK_ORDER: {
+        auto snapshot = session.getSnapshot();
+        if (snapshot->cart && !snapshot->reserve_time.empty()) {
+          session.checkOrder(snapshot, snapshot->reserve_time.front(), order,
+                             code);
+        }
+        break;
+      }
+      case ddshop::Endpoint::ADD_NEW_ORDER:
+        session.doOrder(order, code);
+        break;
+      case ddshop::Endpoint::NOT_PAY_LIST:
+        session.hasUnpaidOrder();
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+void BM_Replay(benchmark::State &state, const std::string &path,
+               const std::vector<ddshop::CassetteEntry> &entries) {
+  ddshop::SessionConfig config;
+  config.cookie = "replay";
+  config.replay_cassette = path;
+  config.replay_fast = true;
+  uint64_t allocs = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto session = ddshop::Session::buildSession(config);
+    auto start = bench::allocCount().load(std::memory_order_relaxed);
+    state.ResumeTiming();
+    replay(*session, entries);
+    allocs += bench::allocCount().load(std::memory_order_relaxed) - start;
+  }
+  state.counters["allocs/op"] = benchmark::Counter(
+      static_cast<double>(allocs), benchmark::Counter::kAvgIterations);
+  state.counters["requests"] = static_cast<double>(entries.size());
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  benchmark::Initialize(&argc, argv);
+  if (argc < 2) {
+    fprintf(stderr, "Usage: replay_session cassette [benchmark flags]\n");
+    return 1;
+  }
+  spdlog::set_level(spdlog::level::off);
+  std::string path = argv[1];
+  std::vector<ddshop::CassetteEntry> entries;
+  if (!ddshop::readCassette(path, entries)) {
+    return 1;
+  }
+  benchmark::RegisterBenchmark("BM_Replay", BM_Replay, path, entries)
+      ->Unit(benchmark::kMicrosecond);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
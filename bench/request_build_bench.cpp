@@ -0,0 +1,174 @@
+// Compares building a request the old way (copying and re-encoding the base
+// params and headers per request) with appending to the pre-encoded base
+// query in a reused thread-local buffer, first for the body alone and then
+// for the whole request sent through ClientPool to a local server. The
+// whole-request numbers count the sending thread only.
+#include <thread>
+
+#include "alloc_counter.hpp"
+#include "client_pool.hpp"
+#include "form_buffer.hpp"
+#include "httplib.h"
+
+namespace {
+
+httplib::Params baseParams() {
+  httplib::Params params;
+  params.emplace("uid", "1234567890abcdef12345678");
+  params.emplace("longitude", "121.473701");
+  params.emplace("latitude", "31.230416");
+  params.emplace("station_id", "5b6b8a3cc0a1ea8c3e8b4567");
+  params.emplace("city_number", "0101");
+  params.emplace("api_version", "9.49.2");
+  params.emplace("app_version", "2.81.0");
+  params.emplace("applet_source", "");
+  params.emplace("channel", "applet");
+  params.emplace("app_client_id", "4");
+  params.emplace("sharer_uid", "");
+  params.emplace("s_id", "0123456789abcdef0123456789abcdef");
+  params.emplace("openid", "");
+  params.emplace("h5_source", "");
+  params.emplace("device_token", "");
+  params.emplace("nars", "");
+  params.emplace("sesi", "");
+  return params;
+}
+
+httplib::Headers baseHeaders() {
+  httplib::Headers headers;
+  headers.emplace("Host", "maicai.api.ddxq.mobi");
+  headers.emplace("ddmc-city-number", "0101");
+  headers.emplace("ddmc-build-version", "2.81.0");
+  headers.emplace("ddmc-station-id", "5b6b8a3cc0a1ea8c3e8b4567");
+  headers.emplace("ddmc-channel", "applet");
+  headers.emplace("ddmc-os-version", "[object Undefined]");
+  headers.emplace("ddmc-app-client-id", "4");
+  headers.emplace("Cookie", "DDXQSESSID=0123456789abcdef0123456789abcdef");
+  headers.emplace("ddmc-ip", "");
+  headers.emplace("ddmc-longitude", "121.473701");
+  headers.emplace("ddmc-latitude", "31.230416");
+  headers.emplace("ddmc-api-version", "9.49.2");
+  headers.emplace("ddmc-uid", "1234567890abcdef12345678");
+  headers.emplace("Accept-Encoding", "gzip, deflate, br");
+  headers.emplace("Referer",
+                  "https://servicewechat.com/wx1e113254eda17715/425/"
+                  "page-frame.html");
+  return headers;
+}
+
+const std::string PACKAGES_HEAD = httplib::detail::encode_query_param(
+    R"([{"products":[],"total_money":"88.00","reserved_time":)"
+    R"({"reserved_time_start":)");
+
+void BM_CopyParams(benchmark::State &state) {
+  const auto params = baseParams();
+  const auto headers = baseHeaders();
+  bench::AllocCounter allocs(state);
+  for (auto _ : state) {
+    auto copy = params;
+    auto request_headers = headers;
+    auto body = httplib::detail::params_to_query_str(copy);
+    body.append("&packages=").append(PACKAGES_HEAD);
+    body.append(std::to_string(1650000000)).append("%2C");
+    body.append(std::to_string(1650003600));
+    benchmark::DoNotOptimize(body.data());
+    benchmark::DoNotOptimize(request_headers);
+  }
+}
+BENCHMARK(BM_CopyParams);
+
+void BM_PreEncoded(benchmark::State &state) {
+  const auto query = httplib::detail::params_to_query_str(baseParams());
+  bench::AllocCounter allocs(state);
+  for (auto _ : state) {
+    auto &body = ddshop::formBuffer(query);
+    body.append("&packages=").append(PACKAGES_HEAD);
+    ddshop::appendNumber(body, 1650000000).append("%2C");
+    ddshop::appendNumber(body, 1650003600);
+    benchmark::DoNotOptimize(body.data());
+  }
+}
+BENCHMARK(BM_PreEncoded);
+
+// Answers every checkOrder on loopback for as long as the process runs.
+class LocalServer {
+ public:
+  LocalServer() {
+    server_.set_tcp_nodelay(true);
+    server_.Post("/order/checkOrder",
+                 [](const httplib::Request &, httplib::Response &res) {
+                   res.set_content(R"({"success":true})", "application/json");
+                 });
+    port_ = server_.bind_to_any_port("127.0.0.1");
+    thread_ = std::thread([this]() { server_.listen_after_bind(); });
+    thread_.detach();
+  }
+
+  std::string host() const {
+    return "http://127.0.0.1:" + std::to_string(port_);
+  }
+
+ private:
+  httplib::Server server_;
+  int port_;
+  std::thread thread_;
+};
+
+std::string &checkOrderBody(const std::string &query) {
+  auto &body = ddshop::formBuffer(query);
+  body.append("&packages=").append(PACKAGES_HEAD);
+  ddshop::appendNumber(body, 1650000000).append("%2C");
+  ddshop::appendNumber(body, 1650003600);
+  return body;
+}
+
+// Sends one checkOrder per iteration, with the body copied into the request
+// (swap false) or swapped in and back the way SessionImpl::post does it.
+void sendCheckOrder(benchmark::State &state, bool swap) {
+  static LocalServer server;
+  ddshop::ClientPool pool(server.host(), 1, [](httplib::Client &) {});
+  pool.setDefaultHeaders(baseHeaders());
+  const auto query = httplib::detail::params_to_query_str(baseParams());
+  // Opens the connection outside the measured loop.
+  if (pool.warmUp("/") == 0) {
+    state.SkipWithError("local server not reachable");
+    return;
+  }
+  bench::AllocCounter allocs(state, true);
+  for (auto _ : state) {
+    auto &body = checkOrderBody(query);
+    httplib::Request req;
+    req.method = "POST";
+    req.path = "/order/checkOrder";
+    req.headers.emplace("Content-Type", "application/x-www-form-urlencoded");
+    if (swap) {
+      req.body.swap(body);
+    } else {
+      req.body = body;
+    }
+    ddshop::RequestPhases phases;
+    phases.start = std::chrono::steady_clock::now();
+    auto res = pool.send(ddshop::RequestClass::CHECK, req, phases);
+    if (swap) {
+      body.swap(req.body);
+    }
+    if (!res || res->status != 200) {
+      state.SkipWithError("checkOrder failed");
+      break;
+    }
+  }
+}
+
+void BM_SendCopiedBody(benchmark::State &state) {
+  sendCheckOrder(state, false);
+}
+BENCHMARK(BM_SendCopiedBody);
+
+void BM_SendSwappedBody(benchmark::State &state) {
+  sendCheckOrder(state, true);
+}
+BENCHMARK(BM_SendSwappedBody);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,146 @@
+// Contention between order workers reading the cart and the workers
+// publishing it: the former cart_mutex_ + deep copy versus the snapshot
+// cell. lock_wait_ns is the average time a reader spends before it can
+// read, writer_wait_ns the same for the publishing thread. Snapshot readers
+// only take the shared_ptr lock on the first load after each publish.
+#include <chrono>
+#include <mutex>
+
+#include "benchmark/benchmark.h"
+#include "ddshop/session.hpp"
+#include "snapshot_cell.hpp"
+
+namespace {
+
+const int PUBLISH_EVERY = 64;
+
+nlohmann::json makeCart(size_t products) {
+  nlohmann::json cart;
+  for (size_t i = 0; i < products; ++i) {
+    nlohmann::json product;
+    product["id"] = "5f" + std::to_string(1000000 + i);
+    product["product_name"] = "商品" + std::to_string(i);
+    product["count"] = 1;
+    product["price"] = "9.90";
+    product["total_price"] = "9.90";
+    product["origin_price"] = "12.80";
+    product["total_origin_price"] = "12.80";
+    product["sizes"] = nlohmann::json::array();
+    product["type"] = 1;
+    product["category_path"] = "58fbf4fb936edfe3568b4567";
+    product["batch_type"] = -1;
+    cart["products"].emplace_back(std::move(product));
+  }
+  cart["parent_order_sign"] = "3b1b4d5a1c0d9b6e8d9a5c7e2f0a4b6c";
+  cart["total_money"] = "297.00";
+  return cart;
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> makeTimes(size_t n) {
+  std::vector<std::pair<uint64_t, uint64_t>> times;
+  for (size_t i = 0; i < n; ++i) {
+    times.emplace_back(1650000000 + i * 1800, 1650000000 + (i + 1) * 1800);
+  }
+  return times;
+}
+
+uint64_t nanosSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+struct LockedCart {
+  std::mutex mutex;
+  nlohmann::json cart = makeCart(30);
+  std::vector<std::pair<uint64_t, uint64_t>> reserve_time = makeTimes(20);
+};
+
+void BM_MutexDeepCopy(benchmark::State &state) {
+  static LockedCart shared;
+  uint64_t wait_ns = 0;
+  uint64_t writer_ns = 0;
+  uint64_t writes = 0;
+  uint64_t iterations = 0;
+  for (auto _ : state) {
+    if (state.thread_index() == 0 && iterations % PUBLISH_EVERY == 0) {
+      auto times = makeTimes(20);
+      auto start = std::chrono::steady_clock::now();
+      std::lock_guard<std::mutex> lck(shared.mutex);
+      writer_ns += nanosSince(start);
+      ++writes;
+      shared.reserve_time.swap(times);
+    }
+    auto start = std::chrono::steady_clock::now();
+    nlohmann::json cart;
+    std::vector<std::pair<uint64_t, uint64_t>> reserve_time;
+    {
+      std::lock_guard<std::mutex> lck(shared.mutex);
+      wait_ns += nanosSince(start);
+      cart = shared.cart;
+      reserve_time = shared.reserve_time;
+    }
+    benchmark::DoNotOptimize(cart);
+    benchmark::DoNotOptimize(reserve_time);
+    ++iterations;
+  }
+  state.counters["lock_wait_ns"] =
+      benchmark::Counter(wait_ns, benchmark::Counter::kAvgIterations);
+  if (writes) {
+    state.counters["writer_wait_ns"] = writer_ns / writes;
+  }
+}
+
+void BM_SnapshotLoad(benchmark::State &state) {
+  static ddshop::SnapshotCell<ddshop::CartSnapshot> shared;
+  if (state.thread_index() == 0) {
+    auto cart = std::make_shared<ddshop::Cart>();
+    cart->products.resize(30);
+    cart->products_form = makeCart(30).dump();
+    shared.update([&cart](const ddshop::CartSnapshot &,
+                          ddshop::CartSnapshot &next) {
+      next.cart = cart;
+      next.reserve_time = makeTimes(20);
+      return true;
+    });
+  }
+  uint64_t wait_ns = 0;
+  uint64_t writer_ns = 0;
+  uint64_t writes = 0;
+  uint64_t iterations = 0;
+  for (auto _ : state) {
+    if (state.thread_index() == 0 && iterations % PUBLISH_EVERY == 0) {
+      auto times = makeTimes(20);
+      auto start = std::chrono::steady_clock::now();
+      shared.update([&times](const ddshop::CartSnapshot &current,
+                             ddshop::CartSnapshot &next) {
+        next.cart = current.cart;
+        next.reserve_time = times;
+        return true;
+      });
+      writer_ns += nanosSince(start);
+      ++writes;
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto snapshot = shared.load();
+    wait_ns += nanosSince(start);
+    benchmark::DoNotOptimize(snapshot->reserve_time.size());
+    ++iterations;
+  }
+  state.counters["lock_wait_ns"] =
+      benchmark::Counter(wait_ns, benchmark::Counter::kAvgIterations);
+  if (writes) {
+    state.counters["writer_wait_ns"] = writer_ns / writes;
+  }
+}
+
+}  // namespace
+
+BENCHMARK(BM_MutexDeepCopy)
+    ->Threads(2)
+    ->Threads(8)
+    ->Threads(32)
+    ->UseRealTime();
+BENCHMARK(BM_SnapshotLoad)->Threads(2)->Threads(8)->Threads(32)->UseRealTime();
+
+BENCHMARK_MAIN();
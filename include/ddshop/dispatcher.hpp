@@ -1,18 +1,16 @@
 #pragma once
+#include <chrono>
 #include <functional>
 #include <memory>
 #include <vector>
 
+#include "ddshop/schedule.hpp"
+
 namespace ddshop {
 
 class Session;
 class SessionConfig;
 
-struct Schedule {
-  std::pair<uint8_t, uint8_t> start_time;
-  std::pair<uint8_t, uint8_t> stop_time;
-};
-
 class Dispatcher {
  public:
   virtual ~Dispatcher() = default;
@@ -25,10 +23,20 @@ class Dispatcher {
 
   virtual void initBarkNotifier(const std::string &) = 0;
 
+  virtual void initWebhookNotifier(const std::string &url) = 0;
+
+  // Writes a Chrome trace of the worker timelines to path whenever the
+  // workers stop.
+  virtual void initTrace(const std::string &path) = 0;
+
   virtual std::shared_ptr<Session> getSession() = 0;
 
   virtual void setSchedule(const std::vector<Schedule> &) = 0;
 
+  // Warms the session up this long before each scheduled window starts.
+  // Zero, the default, disables the warm-up.
+  virtual void setWarmup(std::chrono::seconds lead) = 0;
+
   virtual void onSuccess(std::function<void(const std::string &)>) = 0;
 
   static std::shared_ptr<Dispatcher> makeDispatcher();
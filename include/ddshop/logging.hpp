@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+namespace ddshop {
+
+enum class LogProfile {
+  // For the schedule window. Each thread copies its messages into its own
+  // ring and never blocks; messages are cut to a bounded length and
+  // dropped, and counted, when the ring is full.
+  HOT_PATH,
+  // Every message is kept in full; a thread blocks while the writer falls
+  // behind.
+  LOSSLESS
+};
+
+// Installs the default "ddshop" logger writing to sinks, replacing the
+// previous one.
+void setupLogging(const std::vector<spdlog::sink_ptr> &sinks,
+                  LogProfile profile);
+
+// Messages dropped by the HOT_PATH profile so far.
+uint64_t droppedLogMessages();
+
+// The worker name of the thread with spdlog thread id thread_id, or empty.
+// Sinks may run on another thread, so log views look the name up by the
+// message's thread id.
+std::string logThreadName(size_t thread_id);
+
+}  // namespace ddshop
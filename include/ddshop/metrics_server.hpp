@@ -0,0 +1,20 @@
+#pragma once
+#include <memory>
+#include <string>
+
+namespace ddshop {
+
+// Serves the client's metrics in Prometheus text format at /metrics and the
+// worker timelines as a Chrome trace at /trace from its own thread.
+class MetricsServer {
+ public:
+  virtual ~MetricsServer() = default;
+
+  virtual int port() const = 0;
+
+  // Returns nullptr if the address cannot be bound.
+  static std::shared_ptr<MetricsServer> makeMetricsServer(
+      const std::string &host, int port);
+};
+
+}  // namespace ddshop
@@ -0,0 +1,42 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+
+namespace ddshop {
+
+// A daily window in local time at second resolution.
+struct Schedule {
+  // Seconds since local midnight. A stop at or before the start ends the
+  // window on the next day.
+  uint32_t start = 0;
+  uint32_t stop = 0;
+  // Days the window may start on, bit 0 for Sunday.
+  uint8_t weekdays = 0x7F;
+  // Local dates as YYYYMMDD. If set the window only starts on these days.
+  std::vector<uint32_t> dates;
+};
+
+struct ScheduleWindow {
+  std::chrono::system_clock::time_point start;
+  std::chrono::system_clock::time_point stop;
+};
+
+// Finds the window open at now, or else the next one to open, with windows
+// that overlap it merged in. Returns false if no window opens again.
+bool nextWindow(const std::vector<Schedule> &schedules,
+                std::chrono::system_clock::time_point now,
+                ScheduleWindow &window);
+
+// Reads {"start": [h, m, s], "stop": [h, m, s], "weekdays": [1, ..., 7],
+// "dates": ["2022-04-16"]}. Seconds, weekdays (1 for Monday) and dates are
+// optional.
+bool parseSchedule(const nlohmann::json &json, Schedule &schedule);
+
+// e.g. "05:59:30 - 06:03:00 on 1,2,3,4,5"
+std::string describeSchedule(const Schedule &schedule);
+
+}  // namespace ddshop
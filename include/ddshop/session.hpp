@@ -15,6 +15,27 @@ struct SessionConfig {
   std::string cookie;
   Channel channel = Channel::APP;
   PayType pay_type = PayType::ALIPAY;
+  size_t pool_size = 6;
+  // Replaces both ddxq API hosts when set, e.g. "http://127.0.0.1:8080" for
+  // the local mock server.
+  std::string base_url;
+  // Requests slower than this are logged with their phase breakdown.
+  uint32_t slow_request_ms = 1000;
+  // When set, every request and response is kept in a per-worker ring file
+  // in this directory. Decode with tools/flight_decode.
+  std::string flight_recorder_dir;
+  // Saves every request/response pair of the session to this file.
+  std::string record_cassette;
+  // Serves responses from a recorded cassette instead of the network, with
+  // the recorded latencies unless replay_fast is set.
+  std::string replay_cassette;
+  bool replay_fast = false;
+  // Hosts listed in this /etc/hosts style file resolve from it instead of
+  // DNS, e.g. to point the API hosts at a local stand-in.
+  std::string hosts_file;
+  // Asks for gzip or deflate encoded responses, which shrinks the cart and
+  // reserve time payloads on the wire at the cost of decoding them.
+  bool compression = true;
 };
 
 struct Address {
@@ -28,9 +49,45 @@ struct Address {
   std::string station_id;
 };
 
+struct CartProduct {
+  std::string id;
+  std::string name;
+  uint64_t count;
+  std::string total_price;
+};
+
+struct Cart {
+  std::vector<CartProduct> products;
+  std::string total_money;
+  std::string parent_order_sign;
+  // Form field values serialized and URL-encoded once per cart refresh. The
+  // *_head fields stop right before the reserved_time_start value, which is
+  // spliced in per attempt.
+  std::string products_form;
+  std::string packages_head;
+  std::string package_order_head;
+};
+
+// Immutable cart state. A new version is published as a whole on every
+// change, so readers hold a reference instead of locking or copying.
+struct CartSnapshot {
+  uint64_t version = 0;
+  std::shared_ptr<const Cart> cart;
+  std::vector<std::pair<uint64_t, uint64_t>> reserve_time;
+};
+
+// What a warm-up ahead of a schedule window got ready.
+struct WarmupReport {
+  size_t connections = 0;
+  size_t pool_size = 0;
+  bool cart = false;
+
+  bool ready() const { return cart && connections == pool_size; }
+};
+
 struct Order {
   std::pair<uint64_t, uint64_t> reserve_time;
-  nlohmann::json cart_data;
+  std::shared_ptr<const CartSnapshot> snapshot;
   nlohmann::json check_order_data;
 };
 
@@ -49,11 +106,18 @@ class Session {
   virtual bool cartCheckAll() = 0;
   virtual bool getCart() = 0;
   virtual bool refreshReserveTime() = 0;
-  virtual void getReserveTime(std::vector<std::pair<uint64_t, uint64_t>> &) = 0;
-  virtual bool checkOrder(const std::pair<uint64_t, uint64_t> &, Order &,
+  virtual std::shared_ptr<const CartSnapshot> getSnapshot() = 0;
+  virtual bool checkOrder(const std::shared_ptr<const CartSnapshot> &,
+                          const std::pair<uint64_t, uint64_t> &, Order &,
                           int &) = 0;
   virtual bool doOrder(Order &, int &) = 0;
   virtual int hasUnpaidOrder() = 0;
+  virtual void logStats() = 0;
+  // Opens and verifies every pooled connection and loads the cart, so the
+  // first requests of a window find everything in place.
+  virtual WarmupReport warmUp() = 0;
+  // Makes the requests in flight fail at once, e.g. when stopping.
+  virtual void cancel() = 0;
 
   static std::shared_ptr<Session> buildSession(SessionConfig config);
 };
@@ -2,13 +2,16 @@
 
 #include <memory>
 
+#include "notification/sink.hpp"
+
 namespace notification {
 
-class BarkNotifier {
+class BarkNotifier : public Sink {
  public:
-  virtual bool notify(const std::string &) = 0;
-
-  static std::shared_ptr<BarkNotifier> makeBarkNotifier(const std::string &);
+  static std::shared_ptr<BarkNotifier> makeBarkNotifier(
+      const std::string &bark_id,
+      const std::string &server = "https://api.day.app",
+      ClientSetup setup = nullptr);
 };
 
 }  // namespace notification
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "notification/sink.hpp"
+
+namespace notification {
+
+// Delivers messages to the sinks from its own thread. Posting only enqueues,
+// so the caller never waits on a sink. A message identical to one delivered
+// within the coalescing window is dropped.
+class Notifier {
+ public:
+  virtual ~Notifier() = default;
+
+  // Returns false if the queue is full and the message was dropped.
+  virtual bool post(std::string msg) = 0;
+
+  virtual void addSink(std::shared_ptr<Sink>) = 0;
+
+  // Delivers the messages still queued and joins the thread.
+  virtual void stop() = 0;
+
+  static std::shared_ptr<Notifier> makeNotifier(
+      std::chrono::milliseconds coalesce_window);
+};
+
+}  // namespace notification
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace httplib {
+class Client;
+}
+
+namespace notification {
+
+// Called on the HTTP client of a sink once it is created, e.g. to apply the
+// transport settings of the caller.
+using ClientSetup = std::function<void(httplib::Client &)>;
+
+// A notification backend. Sinks are only called from the notifier thread,
+// one message at a time, so they may keep their connection open between
+// messages.
+class Sink {
+ public:
+  virtual ~Sink() = default;
+
+  virtual const char *name() const = 0;
+
+  virtual bool notify(const std::string &) = 0;
+
+  static std::shared_ptr<Sink> makeCallbackSink(
+      std::function<void(const std::string &)>);
+};
+
+}  // namespace notification
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <memory>
+
+#include "notification/sink.hpp"
+
+namespace notification {
+
+// POSTs {"msg": "..."} as JSON to an HTTP(S) endpoint, e.g. a local
+// automation hook.
+class WebhookNotifier : public Sink {
+ public:
+  static std::shared_ptr<WebhookNotifier> makeWebhookNotifier(
+      const std::string &url, ClientSetup setup = nullptr);
+};
+
+}  // namespace notification
@@ -0,0 +1,183 @@
+// Headless runner for servers: no Qt and no display. Stops on SIGINT,
+// SIGTERM or SIGHUP.
+#include <pthread.h>
+
+#include <csignal>
+#include <fstream>
+
+#include "ddshop/dispatcher.hpp"
+#include "ddshop/logging.hpp"
+#include "ddshop/metrics_server.hpp"
+#include "ddshop/session.hpp"
+#include "spdlog/sinks/rotating_file_sink.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include "spdlog/spdlog.h"
+
+int main(int argc, char **argv) {
+  // Blocked before any thread is started so every thread inherits the mask
+  // and the signals are only taken by the sigwait below, where stopping the
+  // dispatcher is safe.
+  sigset_t stop_signals;
+  sigemptyset(&stop_signals);
+  sigaddset(&stop_signals, SIGINT);
+  sigaddset(&stop_signals, SIGTERM);
+  sigaddset(&stop_signals, SIGHUP);
+  pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+
+  auto console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+  console_sink->set_level(spdlog::level::info);
+
+  auto file_sink = std::make_shared<spdlog::sinks::rotating_file_sink_mt>(
+      "ddshop.log", 30000000, 3);
+  file_sink->set_level(spdlog::level::debug);
+
+  std::vector<spdlog::sink_ptr> sinks{console_sink, file_sink};
+
+  if (argc != 2) {
+    printf("Usage: ddshop_cli config.json\n");
+    return -1;
+  }
+
+  std::ifstream fin(argv[1]);
+  if (!fin.good()) {
+    spdlog::error("Failed to open config file");
+    return -1;
+  }
+  std::string config_json_str((std::istreambuf_iterator<char>(fin)),
+                              std::istreambuf_iterator<char>());
+  auto config_json = nlohmann::json::parse(config_json_str, nullptr, false);
+  if (config_json.is_discarded()) {
+    spdlog::error("Failed to parse config file");
+    return -1;
+  }
+  auto log_profile = ddshop::LogProfile::HOT_PATH;
+  if (config_json.contains("log_profile") &&
+      config_json["log_profile"] == "lossless") {
+    log_profile = ddshop::LogProfile::LOSSLESS;
+  }
+  ddshop::setupLogging(sinks, log_profile);
+
+  if (!config_json.contains("cookie")) {
+    spdlog::error("Config file must contain cookie");
+    return -1;
+  }
+
+  ddshop::SessionConfig config{};
+  config.cookie = config_json["cookie"];
+  if (config_json.contains("channel")) {
+    if (config_json["channel"] == "app" || config_json["channel"] == "APP") {
+      spdlog::info("Using app channel");
+      config.channel = ddshop::Channel::APP;
+    } else if (config_json["channel"] == "applet" ||
+               config_json["channel"] == "APPLET") {
+      spdlog::info("Using applet channel");
+      config.channel = ddshop::Channel::APPLET;
+    }
+  }
+  if (config_json.contains("pay_type")) {
+    if (config_json["pay_type"] == "alipay" ||
+        config_json["pay_type"] == "ALIPAY") {
+      spdlog::info("Using alipay");
+      config.pay_type = ddshop::PayType::ALIPAY;
+    } else if (config_json["pay_type"] == "wechat" ||
+               config_json["pay_type"] == "WECHAT") {
+      spdlog::info("Using wechat");
+      config.pay_type = ddshop::PayType::WECHAT;
+    }
+  }
+
+  if (config_json.contains("pool_size") &&
+      config_json["pool_size"].is_number_unsigned()) {
+    config.pool_size = config_json["pool_size"];
+    spdlog::info("Using {} pooled connections", config.pool_size);
+  }
+  if (config_json.contains("base_url")) {
+    config.base_url = config_json["base_url"];
+  }
+  if (config_json.contains("slow_request_ms") &&
+      config_json["slow_request_ms"].is_number_unsigned()) {
+    config.slow_request_ms = config_json["slow_request_ms"];
+  }
+  if (config_json.contains("flight_recorder_dir")) {
+    config.flight_recorder_dir = config_json["flight_recorder_dir"];
+  }
+  if (config_json.contains("record_cassette")) {
+    config.record_cassette = config_json["record_cassette"];
+  }
+  if (config_json.contains("replay_cassette")) {
+    config.replay_cassette = config_json["replay_cassette"];
+    config.replay_fast = config_json.value("replay_fast", false);
+  }
+  if (config_json.contains("hosts_file")) {
+    config.hosts_file = config_json["hosts_file"];
+  }
+  config.compression = config_json.value("compression", config.compression);
+
+  std::shared_ptr<ddshop::MetricsServer> metrics_server;
+  if (config_json.contains("metrics_port")) {
+    metrics_server = ddshop::MetricsServer::makeMetricsServer(
+        "127.0.0.1", config_json["metrics_port"]);
+  }
+
+  auto dispatcher = ddshop::Dispatcher::makeDispatcher();
+  if (!dispatcher->initSession(config)) {
+    spdlog::error("Failed to init session");
+    return -1;
+  }
+  if (config_json.contains("bark_id")) {
+    dispatcher->initBarkNotifier(config_json["bark_id"]);
+  }
+  if (config_json.contains("webhook_url")) {
+    dispatcher->initWebhookNotifier(config_json["webhook_url"]);
+  }
+  if (config_json.contains("trace_file")) {
+    dispatcher->initTrace(config_json["trace_file"]);
+  }
+
+  if (config_json.contains("schedules")) {
+    std::vector<ddshop::Schedule> schedules;
+    for (auto &it : config_json["schedules"]) {
+      ddshop::Schedule tmp;
+      if (!ddshop::parseSchedule(it, tmp)) {
+        spdlog::error("Invalid schedule {}", it.dump());
+        continue;
+      }
+      schedules.emplace_back(std::move(tmp));
+    }
+    if (!schedules.empty()) {
+      dispatcher->setSchedule(schedules);
+    }
+  }
+  if (config_json.contains("warmup_seconds") &&
+      config_json["warmup_seconds"].is_number_unsigned()) {
+    dispatcher->setWarmup(
+        std::chrono::seconds(config_json["warmup_seconds"].get<int64_t>()));
+  }
+
+  std::vector<ddshop::Address> addresses;
+  dispatcher->getSession()->getAddresses(addresses);
+  if (addresses.empty()) {
+    spdlog::error("No address available");
+    return -1;
+  }
+
+  auto address = addresses.back();
+  if (config_json.contains("address_keyword")) {
+    for (auto &it : addresses) {
+      if (it.address.find(config_json["address_keyword"]) !=
+          std::string::npos) {
+        spdlog::info("Filtered address {}", it.address);
+        address = it;
+        break;
+      }
+    }
+  }
+  dispatcher->getSession()->setAddress(address);
+
+  dispatcher->start();
+  int sig = 0;
+  sigwait(&stop_signals, &sig);
+  spdlog::info("Received signal {}, stopping", sig);
+  dispatcher->stop();
+  return 0;
+}
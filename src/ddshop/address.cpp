@@ -8,18 +8,18 @@ void SessionImpl::getAddresses(std::vector<Address> &result) {
     spdlog::debug("Please call initUser before getAddresses");
     throw std::runtime_error("No uid");
   }
-  auto headers = base_headers_;
-  auto params = base_params_;
-  auto tmp_client = httplib::Client("https://sunquan.api.ddxq.mobi");
-  headers.erase("Host");
-  headers.emplace("Host", "sunquan.api.ddxq.mobi");
-  params.emplace("source_type", "5");
-  auto resp = tmp_client.Get("/api/v1/user/address/", params, headers);
+  auto &path = formBuffer("/api/v1/user/address/", base_query_);
+  path.append("&source_type=5");
+  RequestTimer timer(Endpoint::USER_ADDRESS);
+  auto resp = get(user_pool_, RequestClass::HOUSEKEEPING, path, timer);
 
   if (resp.error() == httplib::Error::Success) {
     nlohmann::json ret_data;
     if (!ensureBasicResp(resp->body, ret_data)) {
       spdlog::error("Failed parsing address data");
+      timer.setOutcome(Outcome::JSON_ERROR);
+    } else {
+      timer.setCode(ret_data["success"] ? 0 : ret_data["code"].get<int64_t>());
     }
     result.clear();
     if (ret_data["data"]["valid_address"].empty()) {
@@ -71,6 +71,8 @@ void SessionImpl::setAddress(const Address &addr) {
   base_params_.emplace("city_number", addr.city_number);
   base_params_.emplace("longitude", std::to_string(addr.longitude));
   base_params_.emplace("latitude", std::to_string(addr.latitude));
+
+  rebuildBaseRequest();
 }
 
 }  // namespace ddshop
@@ -3,18 +3,108 @@
 
 namespace ddshop {
 
+namespace {
+
+// Package fields copied verbatim from the cart response.
+const char *const PACKAGE_FIELDS[] = {
+    "package_type",
+    "package_id",
+    "total_money",
+    "total_origin_money",
+    "goods_real_money",
+    "total_count",
+    "cart_count",
+    "is_presale",
+    "instant_rebate_money",
+    "used_balance_money",
+    "can_used_balance_money",
+    "used_point_num",
+    "used_point_money",
+    "can_used_point_num",
+    "can_used_point_money",
+    "is_share_station",
+    "only_today_products",
+    "only_tomorrow_products",
+    "front_package_text",
+    "front_package_type",
+    "front_package_stock_color",
+    "front_package_bg_color",
+};
+
+const std::string CART_AB_CONFIG = httplib::detail::encode_query_param(
+    R"({"key_onion":"D","key_cart_discount_price":"C"})");
+
+std::string asString(const nlohmann::json &value) {
+  return value.is_string() ? value.get<std::string>() : value.dump();
+}
+
+}  // namespace
+
+bool SessionImpl::parseCart(const nlohmann::json &data, Cart &cart) {
+  if (!data.contains("new_order_product_list") ||
+      data["new_order_product_list"].empty()) {
+    return false;
+  }
+  const auto &item = data["new_order_product_list"][0];
+  auto item_products = item.find("products");
+  if (item_products == item.end() || !item_products->is_array()) {
+    return false;
+  }
+
+  nlohmann::json package;
+  auto &products = package["products"];
+  cart.products.clear();
+  cart.products.reserve(item_products->size());
+  for (auto &it : *item_products) {
+    CartProduct product;
+    product.id = asString(it.value("id", nlohmann::json()));
+    product.name = asString(it.value("product_name", nlohmann::json()));
+    product.count = it.value("count", 0ULL);
+    product.total_price = asString(it.value("total_price", nlohmann::json()));
+    cart.products.emplace_back(std::move(product));
+
+    products.emplace_back(it);
+    products.back()["total_money"] = it.value("total_price", nlohmann::json());
+    products.back()["total_origin_money"] =
+        it.value("total_origin_price", nlohmann::json());
+  }
+  for (auto field : PACKAGE_FIELDS) {
+    package[field] = item.value(field, nlohmann::json());
+  }
+  package["parent_order_sign"] =
+      data.value("parent_order_info", nlohmann::json::object())
+          .value("parent_order_sign", nlohmann::json());
+
+  cart.total_money = asString(package["total_money"]);
+  cart.parent_order_sign = asString(package["parent_order_sign"]);
+
+  // Serialize and encode everything once, leaving the package object open
+  // so the reserved time can be appended per attempt.
+  auto head = package.dump();
+  head.pop_back();
+  cart.products_form =
+      httplib::detail::encode_query_param("[" + products.dump() + "]");
+  cart.packages_head = httplib::detail::encode_query_param(
+      "[" + head + R"(,"reserved_time":{"reserved_time_start":)");
+  cart.package_order_head = httplib::detail::encode_query_param(
+      R"({"packages":[)" + head + R"(,"reserved_time_start":)");
+  return true;
+}
+
 bool SessionImpl::cartCheckAll() {
   if (base_params_.find("address_id") == base_params_.end()) {
     spdlog::debug("Please set address first!");
     return false;
   }
 
-  auto params = base_params_;
-  params.emplace("is_check", "1");
-  auto resp = client_.Get("/cart/allCheck", params, base_headers_);
+  auto &path = formBuffer("/cart/allCheck", base_query_);
+  path.append("&is_check=1");
+  RequestTimer timer(Endpoint::CART_CHECK_ALL);
+  auto resp = get(api_pool_, RequestClass::CART, path, timer);
 
   if (resp.error() == httplib::Error::Success) {
-    spdlog::debug("Check all success");
+    timer.setOutcome(Outcome::OK);
+    SPDLOG_DEBUG("Check all success");
     return true;
   } else {
     spdlog::error("Failed to check all");
@@ -28,76 +118,44 @@ bool SessionImpl::getCart() {
     return false;
   }
 
-  auto params = base_params_;
-  params.emplace("is_load", "1");
-  params.emplace("ab_config",
-                 R"({"key_onion":"D","key_cart_discount_price":"C"})");
+  auto &path = formBuffer("/cart/index", base_query_);
+  path.append("&is_load=1&ab_config=").append(CART_AB_CONFIG);
 
   spdlog::info("Getting cart products");
-  auto resp = client_.Get("/cart/index", params, base_headers_);
+  RequestTimer timer(Endpoint::CART_INDEX);
+  auto resp = get(api_pool_, RequestClass::CART, path, timer);
   if (resp.error() == httplib::Error::Success) {
     nlohmann::json ret_json;
     if (!ensureBasicResp(resp->body, ret_json)) {
       spdlog::error("Failed parsing json when getting cart");
+      timer.setOutcome(Outcome::JSON_ERROR);
       return false;
     }
     if (!ret_json["success"]) {
+      timer.setCode(ret_json["code"].get<int64_t>());
       spdlog::warn("Failed get cart, code {}, msg {}",
                    ret_json["code"].get<int64_t>(), ret_json["msg"]);
       return false;
     }
+    timer.setOutcome(Outcome::OK);
 
-    nlohmann::json out;
-    if (ret_json["data"]["new_order_product_list"].empty()) {
+    auto cart = std::make_shared<Cart>();
+    if (!parseCart(ret_json["data"], *cart)) {
       spdlog::info("No valid product");
-      {
-        std::lock_guard<std::mutex> lck(cart_mutex_);
-        cart_data_.swap(out);
-        reserve_time_.clear();
-      }
+      clearCart();
       return true;
     }
-    const auto &item = ret_json["data"]["new_order_product_list"][0];
-    spdlog::info("{} available items", item["products"].size());
-    for (auto &it : item["products"]) {
-      spdlog::info("{} x {:d} Total: {}", it["product_name"],
-                   it["count"].get<uint64_t>(), it["total_price"]);
-      out["products"].emplace_back(it);
-      out["products"].back()["total_money"] = it["total_price"];
-      out["products"].back()["total_origin_money"] = it["total_origin_price"];
-    }
-    spdlog::info("-------Total Price {}-------", item["total_money"]);
-    out["package_type"] = item["package_type"];
-    out["package_id"] = item["package_id"];
-    out["total_money"] = item["total_money"];
-    out["total_origin_money"] = item["total_origin_money"];
-    out["goods_real_money"] = item["goods_real_money"];
-    out["total_count"] = item["total_count"];
-    out["cart_count"] = item["cart_count"];
-    out["is_presale"] = item["is_presale"];
-    out["instant_rebate_money"] = item["instant_rebate_money"];
-    // out["coupon_rebate_money"] = 0;
-    // out["total_rebate_money"] = 0;
-    out["used_balance_money"] = item["used_balance_money"];
-    out["can_used_balance_money"] = item["can_used_balance_money"];
-    out["used_point_num"] = item["used_point_num"];
-    out["used_point_money"] = item["used_point_money"];
-    out["can_used_point_num"] = item["can_used_point_num"];
-    out["can_used_point_money"] = item["can_used_point_money"];
-    out["is_share_station"] = item["is_share_station"];
-    out["only_today_products"] = item["only_today_products"];
-    out["only_tomorrow_products"] = item["only_tomorrow_products"];
-    out["front_package_text"] = item["front_package_text"];
-    out["front_package_type"] = item["front_package_type"];
-    out["front_package_stock_color"] = item["front_package_stock_color"];
-    out["front_package_bg_color"] = item["front_package_bg_color"];
-
-    out["parent_order_sign"] =
-        ret_json["data"]["parent_order_info"]["parent_order_sign"];
-    {
-      std::lock_guard<std::mutex> lck(cart_mutex_);
-      cart_data_.swap(out);
+    spdlog::info("{} available items", cart->products.size());
+    for (auto &it : cart->products) {
+      SPDLOG_DEBUG("{} x {:d} Total: {}", it.name, it.count, it.total_price);
     }
+    spdlog::info("-------Total Price {}-------", cart->total_money);
+
+    cart_.update([&cart](const CartSnapshot &current, CartSnapshot &next) {
+      next.cart = cart;
+      next.reserve_time = current.reserve_time;
+      return true;
+    });
     return true;
   } else {
     spdlog::error("Failed get cart");
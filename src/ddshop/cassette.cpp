@@ -0,0 +1,158 @@
+#include "cassette.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include "spdlog/spdlog.h"
+
+namespace ddshop {
+
+namespace {
+
+const char CASSETTE_MAGIC[8] = {'D', 'D', 'C', 'A', 'S', 'S', 'E', 'T'};
+const uint32_t CASSETTE_VERSION = 1;
+
+struct EntryRecord {
+  uint64_t offset_ns;
+  uint64_t dur_ns;
+  uint16_t endpoint;
+  uint16_t error;
+  int32_t status;
+  uint32_t method_len;
+  uint32_t path_len;
+  uint32_t request_len;
+  uint32_t response_len;
+};
+
+bool readString(std::ifstream &in, uint32_t len, std::string &out) {
+  out.resize(len);
+  return len == 0 || in.read(&out[0], len);
+}
+
+}  // namespace
+
+bool readCassette(const std::string &path, std::vector<CassetteEntry> &out) {
+  std::ifstream in(path, std::ios::binary);
+  char magic[8];
+  uint32_t version = 0;
+  if (!in.read(magic, sizeof(magic)) ||
+      memcmp(magic, CASSETTE_MAGIC, sizeof(magic)) != 0 ||
+      !in.read(reinterpret_cast<char *>(&version), sizeof(version)) ||
+      version != CASSETTE_VERSION) {
+    spdlog::error("{} is not a cassette", path);
+    return false;
+  }
+  out.clear();
+  EntryRecord record;
+  while (in.read(reinterpret_cast<char *>(&record), sizeof(record))) {
+    CassetteEntry entry;
+    entry.offset_ns = record.offset_ns;
+    entry.dur_ns = record.dur_ns;
+    entry.endpoint = static_cast<Endpoint>(
+        std::min<uint16_t>(record.endpoint, static_cast<uint16_t>(
+                                                Endpoint::COUNT)));
+    entry.error = static_cast<httplib::Error>(record.error);
+    entry.status = record.status;
+    if (!readString(in, record.method_len, entry.method) ||
+        !readString(in, record.path_len, entry.path) ||
+        !readString(in, record.request_len, entry.request_body) ||
+        !readString(in, record.response_len, entry.response_body)) {
+      spdlog::error("Cassette {} is truncated after {} entries", path,
+                    out.size());
+      return false;
+    }
+    out.emplace_back(std::move(entry));
+  }
+  return true;
+}
+
+bool CassetteRecorder::open(const std::string &path) {
+  out_.open(path, std::ios::binary | std::ios::trunc);
+  if (!out_.good()) {
+    spdlog::error("Failed to open cassette {}", path);
+    return false;
+  }
+  out_.write(CASSETTE_MAGIC, sizeof(CASSETTE_MAGIC));
+  out_.write(reinterpret_cast<const char *>(&CASSETTE_VERSION),
+             sizeof(CASSETTE_VERSION));
+  start_ = std::chrono::steady_clock::now();
+  spdlog::info("Recording cassette {}", path);
+  return true;
+}
+
+void CassetteRecorder::append(Endpoint endpoint, uint64_t dur_ns,
+                              const httplib::Request &req,
+                              const httplib::Result &res) {
+  static const std::string EMPTY;
+  auto &body = res ? res->body : EMPTY;
+  EntryRecord record{};
+  record.dur_ns = dur_ns;
+  record.endpoint = static_cast<uint16_t>(endpoint);
+  record.error = static_cast<uint16_t>(res.error());
+  record.status = res ? res->status : -1;
+  record.method_len = req.method.size();
+  record.path_len = req.path.size();
+  record.request_len = req.body.size();
+  record.response_len = body.size();
+
+  std::lock_guard<std::mutex> lck(mutex_);
+  // The request started dur_ns ago.
+  record.offset_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - start_)
+                         .count() -
+                     dur_ns;
+  out_.write(reinterpret_cast<const char *>(&record), sizeof(record));
+  out_.write(req.method.data(), req.method.size());
+  out_.write(req.path.data(), req.path.size());
+  out_.write(req.body.data(), req.body.size());
+  out_.write(body.data(), body.size());
+  out_.flush();
+}
+
+bool CassettePlayer::load(const std::string &path, bool original_timing) {
+  if (!readCassette(path, entries_)) {
+    return false;
+  }
+  original_timing_ = original_timing;
+  for (auto &it : entries_) {
+    if (it.endpoint != Endpoint::COUNT) {
+      by_endpoint_[static_cast<size_t>(it.endpoint)].push_back(&it);
+    }
+  }
+  spdlog::warn("Replaying {} requests from cassette {}", entries_.size(),
+               path);
+  return true;
+}
+
+httplib::Result CassettePlayer::play(Endpoint endpoint) {
+  auto e = static_cast<size_t>(endpoint);
+  const CassetteEntry *entry = nullptr;
+  {
+    std::lock_guard<std::mutex> lck(mutex_);
+    auto &recorded = by_endpoint_[e];
+    if (!recorded.empty()) {
+      if (cursor_[e] < recorded.size()) {
+        entry = recorded[cursor_[e]++];
+      } else {
+        entry = recorded.back();
+        ++overruns_;
+      }
+    }
+  }
+  if (!entry) {
+    return httplib::Result(nullptr, httplib::Error::Connection);
+  }
+  if (original_timing_) {
+    std::this_thread::sleep_for(std::chrono::nanoseconds(entry->dur_ns));
+  }
+  if (entry->error != httplib::Error::Success) {
+    return httplib::Result(nullptr, entry->error);
+  }
+  std::unique_ptr<httplib::Response> res(new httplib::Response);
+  res->status = entry->status;
+  res->body = entry->response_body;
+  return httplib::Result(std::move(res), httplib::Error::Success);
+}
+
+}  // namespace ddshop
@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "httplib.h"
+#include "metrics.hpp"
+
+namespace ddshop {
+
+// One recorded request/response pair. offset_ns is the time since
+// recording started and dur_ns the time the response took.
+struct CassetteEntry {
+  uint64_t offset_ns = 0;
+  uint64_t dur_ns = 0;
+  Endpoint endpoint = Endpoint::COUNT;
+  httplib::Error error = httplib::Error::Success;
+  int status = -1;
+  std::string method;
+  std::string path;
+  std::string request_body;
+  std::string response_body;
+};
+
+// Reads a whole cassette. Returns false if the file is missing, not a
+// cassette or truncated.
+bool readCassette(const std::string &path, std::vector<CassetteEntry> &out);
+
+// Appends every exchange of a live session to a cassette file: a short
+// header, then per entry a fixed-size record followed by the strings.
+class CassetteRecorder {
+ public:
+  bool open(const std::string &path);
+
+  void append(Endpoint endpoint, uint64_t dur_ns, const httplib::Request &req,
+              const httplib::Result &res);
+
+ private:
+  std::mutex mutex_;
+  std::ofstream out_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Serves the responses of a cassette instead of the network. Each endpoint
+// replays its own recorded responses in order, whichever thread asks, and
+// repeats the last one once they run out, so runs see the same sequence.
+class CassettePlayer {
+ public:
+  // With original timing each response is held back for as long as it
+  // took when recorded, otherwise it is returned at once.
+  bool load(const std::string &path, bool original_timing);
+
+  httplib::Result play(Endpoint endpoint);
+
+  // Requests served after an endpoint ran out of recorded responses.
+  uint64_t overruns() const { return overruns_; }
+
+ private:
+  static const size_t ENDPOINT_NUM = static_cast<size_t>(Endpoint::COUNT);
+
+  std::vector<CassetteEntry> entries_;
+  bool original_timing_ = false;
+  std::mutex mutex_;
+  std::vector<const CassetteEntry *> by_endpoint_[ENDPOINT_NUM];
+  size_t cursor_[ENDPOINT_NUM] = {};
+  std::atomic<uint64_t> overruns_{0};
+};
+
+}  // namespace ddshop
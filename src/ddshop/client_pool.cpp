@@ -0,0 +1,223 @@
+#include "client_pool.hpp"
+
+#include <cstdlib>
+
+#include "spdlog/spdlog.h"
+#include "transport.hpp"
+
+namespace ddshop {
+
+const char *requestClassName(RequestClass cls) {
+  switch (cls) {
+    case RequestClass::SUBMIT:
+      return "submit";
+    case RequestClass::CHECK:
+      return "check";
+    case RequestClass::RESERVE_TIME:
+      return "reserve_time";
+    case RequestClass::CART:
+      return "cart";
+    case RequestClass::HOUSEKEEPING:
+      return "housekeeping";
+    default:
+      return "unknown";
+  }
+}
+
+ClientPool::ClientPool(std::string host, size_t size, Setup setup,
+                       Resolver *resolver)
+    : host_(std::move(host)),
+      size_(size ? size : 1),
+      setup_(std::move(setup)),
+      resolver_(resolver),
+      default_headers_(std::make_shared<const httplib::Headers>()) {
+  clients_.reserve(size_);
+  idle_.reserve(size_);
+  if (resolver_) {
+    auto scheme_end = host_.find("://");
+    auto rest = host_.substr(scheme_end == std::string::npos ? 0
+                                                             : scheme_end + 3);
+    rest = rest.substr(0, rest.find('/'));
+    int port = host_.compare(0, 8, "https://") == 0 ? 443 : 80;
+    auto colon = rest.rfind(':');
+    // Bracketed IPv6 literals need no resolving.
+    if (!rest.empty() && rest[0] != '[') {
+      if (colon != std::string::npos) {
+        port = std::atoi(rest.c_str() + colon + 1);
+        rest.resize(colon);
+      }
+      hostname_ = rest;
+      resolver_->watch(hostname_, port);
+    }
+  }
+}
+
+bool ClientPool::admissible(size_t cls) const {
+  for (size_t i = 0; i < cls; ++i) {
+    if (lanes_[i].waiting) {
+      return false;
+    }
+  }
+  if (cls > static_cast<size_t>(RequestClass::CHECK) && size_ > 1) {
+    return available() > 1;
+  }
+  return available() > 0;
+}
+
+ClientPool::Connection *ClientPool::take() {
+  if (!idle_.empty()) {
+    // Most recently returned first, it is the one most likely still alive.
+    auto conn = idle_.back();
+    idle_.pop_back();
+    return conn;
+  }
+  clients_.emplace_back(new Connection(host_));
+  auto &client = clients_.back()->client;
+  client.set_keep_alive(true);
+  instrumentClient(client);
+  if (setup_) {
+    setup_(client);
+  }
+  spdlog::debug("Pool {} grew to {} connections", host_, clients_.size());
+  return clients_.back().get();
+}
+
+ClientPool::Lease ClientPool::acquire(RequestClass cls) {
+  auto idx = static_cast<size_t>(cls);
+  auto &lane = lanes_[idx];
+  auto wait_start = std::chrono::steady_clock::now();
+  Connection *conn;
+  {
+    std::unique_lock<std::mutex> lck(mutex_);
+    ++lane.waiting;
+    cv_.wait(lck, [this, idx]() { return admissible(idx); });
+    --lane.waiting;
+    conn = take();
+    if (available() > 0) {
+      // Lower classes may have been held back only by this waiter.
+      cv_.notify_all();
+    }
+  }
+  uint64_t wait_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now() - wait_start)
+                         .count();
+  lane.count.fetch_add(1, std::memory_order_relaxed);
+  lane.total_wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+  auto max = lane.max_wait_ns.load(std::memory_order_relaxed);
+  while (wait_ns > max && !lane.max_wait_ns.compare_exchange_weak(
+                              max, wait_ns, std::memory_order_relaxed)) {
+  }
+  return Lease(this, conn);
+}
+
+void ClientPool::release(Connection *conn) {
+  {
+    std::lock_guard<std::mutex> lck(mutex_);
+    idle_.push_back(conn);
+  }
+  // Wake everyone, admissible() lets only the highest class through.
+  cv_.notify_all();
+}
+
+httplib::Result ClientPool::send(RequestClass cls, httplib::Request &req,
+                                 RequestPhases &phases) {
+  auto lease = acquire(cls);
+  phases.acquired = std::chrono::steady_clock::now();
+  auto headers = defaultHeaders();
+  req.headers.insert(headers->begin(), headers->end());
+  return sendOn(lease.connection(), req, phases);
+}
+
+httplib::Result ClientPool::sendOn(Connection &conn, httplib::Request &req,
+                                   RequestPhases &phases) {
+  for (size_t attempt = 1;; ++attempt) {
+    std::string ip;
+    if (resolver_ && resolver_->pick(hostname_, ip) && ip != conn.mapped) {
+      // Only read when the client connects, a live connection stays put.
+      conn.client.set_hostname_addr_map({{hostname_, ip}});
+      conn.mapped = ip;
+    }
+    auto res = sendTimed(conn.client, req, phases);
+    if (phases.dns_done != RequestPhases::TimePoint()) {
+      // A new socket was opened, to the mapped address.
+      conn.ip = conn.mapped;
+    }
+    if (!resolver_ || conn.ip.empty()) {
+      return res;
+    }
+    if (res || (res.error() != httplib::Error::Connection &&
+                res.error() != httplib::Error::ConnectionTimeout)) {
+      if (phases.connected != RequestPhases::TimePoint()) {
+        resolver_->report(hostname_, conn.ip, true,
+                          phases.connected - phases.dns_done);
+      }
+      return res;
+    }
+    resolver_->report(hostname_, conn.ip, false, std::chrono::nanoseconds(0));
+    if (attempt == MAX_CONNECT_ATTEMPTS) {
+      return res;
+    }
+    // Nothing was sent yet, so any request can move to the next address.
+    phases.dns_done = RequestPhases::TimePoint();
+    phases.connected = RequestPhases::TimePoint();
+    phases.tls_done = RequestPhases::TimePoint();
+  }
+}
+
+void ClientPool::setDefaultHeaders(const httplib::Headers &headers) {
+  auto next = std::make_shared<const httplib::Headers>(headers);
+  std::lock_guard<std::mutex> lck(mutex_);
+  default_headers_ = std::move(next);
+}
+
+std::shared_ptr<const httplib::Headers> ClientPool::defaultHeaders() {
+  std::lock_guard<std::mutex> lck(mutex_);
+  return default_headers_;
+}
+
+size_t ClientPool::warmUp(const std::string &path) {
+  // Holding all leases at once makes the pool hand out every connection
+  // instead of the same idle one each time.
+  std::vector<Lease> leases;
+  leases.reserve(size_);
+  for (size_t i = 0; i < size_; ++i) {
+    leases.emplace_back(acquire(RequestClass::SUBMIT));
+  }
+  auto headers = defaultHeaders();
+  size_t ready = 0;
+  for (size_t i = 0; i < leases.size(); ++i) {
+    httplib::Request req;
+    req.method = "GET";
+    req.path = path;
+    req.headers = *headers;
+    RequestPhases phases;
+    phases.start = std::chrono::steady_clock::now();
+    phases.acquired = phases.start;
+    auto res = sendOn(leases[i].connection(), req, phases);
+    if (res) {
+      ++ready;
+      spdlog::info("Warm-up: connection {}/{} to {} ready, {}", i + 1, size_,
+                   host_, phases.describe());
+    } else {
+      spdlog::warn("Warm-up: connection {}/{} to {} failed, {}", i + 1, size_,
+                   host_, httplib::to_string(res.error()));
+    }
+  }
+  return ready;
+}
+
+void ClientPool::cancel() {
+  std::lock_guard<std::mutex> lck(mutex_);
+  for (auto &it : clients_) {
+    it->client.stop();
+  }
+}
+
+LaneStats ClientPool::laneStats(RequestClass cls) const {
+  auto &lane = lanes_[static_cast<size_t>(cls)];
+  return LaneStats{lane.count.load(std::memory_order_relaxed),
+                   lane.total_wait_ns.load(std::memory_order_relaxed),
+                   lane.max_wait_ns.load(std::memory_order_relaxed)};
+}
+
+}  // namespace ddshop
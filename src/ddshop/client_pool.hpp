@@ -0,0 +1,152 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "httplib.h"
+#include "request_phases.hpp"
+#include "resolver.hpp"
+
+namespace ddshop {
+
+// Scheduling classes, highest priority first.
+enum class RequestClass : uint8_t {
+  SUBMIT = 0,
+  CHECK,
+  RESERVE_TIME,
+  CART,
+  HOUSEKEEPING,
+  COUNT
+};
+
+const char *requestClassName(RequestClass cls);
+
+struct LaneStats {
+  uint64_t count;
+  uint64_t total_wait_ns;
+  uint64_t max_wait_ns;
+};
+
+// A fixed-size pool of keep-alive clients bound to one host. Every worker
+// checks out its own connection, so requests never serialize on the
+// request mutex of a shared client and warm TLS sessions are reused.
+//
+// The pool doubles as the request scheduler: a free connection always goes
+// to the highest waiting class, and background classes never take the last
+// free connection, which stays reserved for CHECK and SUBMIT.
+//
+// With a resolver, new connections go to the address it picks instead of
+// resolving the host themselves.
+class ClientPool {
+ public:
+  struct Connection {
+    explicit Connection(const std::string &host) : client(host) {}
+
+    httplib::Client client;
+    // The address the client's next connection goes to, empty if it
+    // resolves the host.
+    std::string mapped;
+    // The address of the client's current connection.
+    std::string ip;
+  };
+
+  class Lease {
+   public:
+    Lease(ClientPool *pool, Connection *conn) : pool_(pool), conn_(conn) {}
+    Lease(Lease &&other) noexcept : pool_(other.pool_), conn_(other.conn_) {
+      other.conn_ = nullptr;
+    }
+    Lease(const Lease &) = delete;
+    void operator=(const Lease &) = delete;
+    ~Lease() {
+      if (conn_) {
+        pool_->release(conn_);
+      }
+    }
+
+    httplib::Client *operator->() const { return &conn_->client; }
+    httplib::Client &operator*() const { return conn_->client; }
+    Connection &connection() const { return *conn_; }
+
+   private:
+    ClientPool *pool_;
+    Connection *conn_;
+  };
+
+  using Setup = std::function<void(httplib::Client &)>;
+
+  // host is a scheme, host and port as httplib::Client takes it.
+  ClientPool(std::string host, size_t size, Setup setup,
+             Resolver *resolver = nullptr);
+
+  Lease acquire(RequestClass cls);
+
+  // Acquires a connection for cls and sends req on it with the default
+  // headers added, timestamping the phases of the request.
+  httplib::Result send(RequestClass cls, httplib::Request &req,
+                       RequestPhases &phases);
+
+  // Sets the headers send() adds to every request. Only call while no
+  // request is in flight, i.e. before the workers start.
+  void setDefaultHeaders(const httplib::Headers &headers);
+
+  // Opens every connection by sending a GET for path on each and returns
+  // how many answered. Connections that are already open are only checked.
+  size_t warmUp(const std::string &path);
+
+  // Aborts the requests in flight on every connection, they fail at once
+  // instead of running into the read timeout. Connections reconnect on
+  // their next request.
+  void cancel();
+
+  LaneStats laneStats(RequestClass cls) const;
+
+  const std::string &host() const { return host_; }
+
+  // The number of connections, at least one.
+  size_t size() const { return size_; }
+
+ private:
+  static constexpr size_t CLASS_NUM = static_cast<size_t>(RequestClass::COUNT);
+  // Connecting moves on to the next address this many times at most.
+  const size_t MAX_CONNECT_ATTEMPTS = 3;
+
+  struct Lane {
+    size_t waiting = 0;
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> total_wait_ns{0};
+    std::atomic<uint64_t> max_wait_ns{0};
+  };
+
+  const std::string host_;
+  const size_t size_;
+  const Setup setup_;
+  Resolver *const resolver_;
+  // host_ without scheme and port, as the client looks it up.
+  std::string hostname_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<std::unique_ptr<Connection>> clients_;
+  std::vector<Connection *> idle_;
+  // Swapped whole under mutex_, so senders only copy the pointer.
+  std::shared_ptr<const httplib::Headers> default_headers_;
+  std::array<Lane, CLASS_NUM> lanes_;
+
+  size_t available() const { return idle_.size() + size_ - clients_.size(); }
+  bool admissible(size_t cls) const;
+  Connection *take();
+  void release(Connection *conn);
+  std::shared_ptr<const httplib::Headers> defaultHeaders();
+  // sendTimed() on conn, connecting to the address the resolver picks and
+  // to the next one if that fails.
+  httplib::Result sendOn(Connection &conn, httplib::Request &req,
+                         RequestPhases &phases);
+};
+
+}  // namespace ddshop
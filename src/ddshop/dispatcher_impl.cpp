@@ -1,21 +1,58 @@
 #include "dispatcher_impl.hpp"
 
+#include <algorithm>
 #include <chrono>
-#include <ctime>
 #include <random>
 
+#include "flight_recorder.hpp"
+#include "notification/bark.hpp"
+#include "notification/webhook.hpp"
+#include "server_clock.hpp"
 #include "session_impl.hpp"
 #include "spdlog/spdlog.h"
+#include "thread_registry.hpp"
+#include "trace.hpp"
+#include "transport.hpp"
 
 namespace ddshop {
 
 DispatcherImpl::DispatcherImpl()
-    : running_(false), nopaid_scan_running_(false), force_order_run_(false) {}
+    : notifier_(notification::Notifier::makeNotifier(NOTIFY_COALESCE_WINDOW)),
+      running_(false),
+      nopaid_scan_running_(false) {
+  metrics_collector_ = addMetricsCollector([this](std::string &out) {
+    out.append(
+           "# HELP ddshop_warmup_ready 1 if the last warm-up opened every "
+           "connection and loaded the cart.\n"
+           "# TYPE ddshop_warmup_ready gauge\n"
+           "ddshop_warmup_ready ")
+        .append(warmup_ready_ ? "1" : "0")
+        .append(
+            "\n# HELP ddshop_warmup_connections Connections opened by the "
+            "last warm-up.\n"
+            "# TYPE ddshop_warmup_connections gauge\n"
+            "ddshop_warmup_connections ")
+        .append(std::to_string(warmup_connections_.load()))
+        .append(
+            "\n# HELP ddshop_warmup_duration_seconds Duration of the last "
+            "warm-up.\n"
+            "# TYPE ddshop_warmup_duration_seconds gauge\n"
+            "ddshop_warmup_duration_seconds ")
+        .append(std::to_string(warmup_ns_.load() / 1e9))
+        .append("\n");
+  });
+}
 
-DispatcherImpl::~DispatcherImpl() { stop(); }
+DispatcherImpl::~DispatcherImpl() {
+  stop();
+  removeMetricsCollector(metrics_collector_);
+}
 
 void DispatcherImpl::spawn() {
   running_ = true;
+  cart_wake_.reset();
+  cart_refreshed_.reset();
+  reserve_time_published_.reset();
   cart_thread_ = std::thread([this]() { cartWorker(); });
   reserve_time_thread_ = std::thread([this]() { reserveTimeWorker(); });
   order_threads_.clear();
@@ -27,28 +64,98 @@ void DispatcherImpl::spawn() {
 
 void DispatcherImpl::scheduleWorker() {
   spdlog::info("Scheduler worker started");
+  setThreadName("scheduler");
+  auto seen = stop_signal_.sequence();
+  ScheduleWindow window;
   while (nopaid_scan_running_) {
-    if (!schedules_.empty()) {
-      bool should_start = false;
-      for (auto &it : schedules_) {
-        if (isTimeInPeriod(it)) {
-          should_start = true;
+    auto now = serverNow();
+    if (!nextWindow(schedules_, now, window)) {
+      spdlog::warn("No schedule window left");
+      break;
+    }
+    if (window.start > now) {
+      auto until = std::chrono::duration_cast<std::chrono::seconds>(
+          window.start - now);
+      auto warm = warmup_lead_.count() > 0 && !warmed_up_;
+      if (warm && until <= warmup_lead_) {
+        // Retried while the lead lasts, the window opens either way.
+        if (!warmUp(until.count()) &&
+            !sleepUntil(std::min(serverNow() + WARMUP_RETRY, window.start),
+                        seen)) {
           break;
         }
+        continue;
       }
-      if (!running_ && should_start) {
-        spdlog::info("Schedule start");
-        spawn();
-      } else if (running_ && !should_start) {
-        spdlog::info("Schedule stop");
-        pause();
+      spdlog::info("Next window opens in {}s", until.count());
+      if (!sleepUntil(warm ? window.start - warmup_lead_ : window.start,
+                      seen)) {
+        break;
       }
+      continue;
+    }
+    if (!running_) {
+      spdlog::info("Schedule start, {:.3f}ms after the window opened on "
+                   "the server clock",
+                   msSince(window.start));
+      spawn();
+    }
+    if (!sleepUntil(window.stop, seen)) {
+      break;
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    spdlog::info("Schedule stop, {:.3f}ms after the window closed",
+                 msSince(window.stop));
+    pause();
+    warmed_up_ = false;
   }
   spdlog::info("Scheduler worker stopped");
 }
 
+bool DispatcherImpl::sleepUntil(std::chrono::system_clock::time_point deadline,
+                                uint64_t &seen) {
+  // The wait runs on the steady clock and is re-anchored to the server clock
+  // at least every MAX_SLEEP. Halving the waits down to FINAL_SLEEP picks up
+  // clock adjustments and new offset estimates close to the deadline.
+  while (nopaid_scan_running_) {
+    auto left = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        deadline - serverNow());
+    if (left <= std::chrono::steady_clock::duration::zero()) {
+      return true;
+    }
+    auto wait = std::min<std::chrono::steady_clock::duration>(
+        left > FINAL_SLEEP ? left / 2 : left, MAX_SLEEP);
+    stop_signal_.waitUntil(std::chrono::steady_clock::now() + wait, seen);
+  }
+  return false;
+}
+
+double DispatcherImpl::msSince(std::chrono::system_clock::time_point t) {
+  return std::chrono::duration<double, std::milli>(serverNow() - t).count();
+}
+
+bool DispatcherImpl::warmUp(int seconds_to_start) {
+  spdlog::info("Warm-up started, {}s before the window", seconds_to_start);
+  TraceSpan span("warmUp");
+  auto start = std::chrono::steady_clock::now();
+  auto report = session_->warmUp();
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+  warmed_up_ = report.ready();
+  warmup_ready_ = report.ready();
+  warmup_connections_ = report.connections;
+  warmup_ns_ = ns;
+  span.setResult(report.ready());
+  if (report.ready()) {
+    spdlog::info("Warm-up ready in {:.1f}ms, {} connections open, cart loaded",
+                 ns / 1e6, report.connections);
+  } else {
+    spdlog::warn("Warm-up incomplete in {:.1f}ms, {}/{} connections open, {}",
+                 ns / 1e6, report.connections, report.pool_size,
+                 report.cart ? "cart loaded" : "no cart");
+  }
+  return report.ready();
+}
+
 void DispatcherImpl::start() {
   if (!session_) {
     spdlog::error("Please init session first");
@@ -56,6 +163,7 @@ void DispatcherImpl::start() {
   }
   if (!nopaid_scan_running_) {
     nopaid_scan_running_ = true;
+    stop_signal_.reset();
     unpaid_thread_ = std::thread([this]() { unpaidWorker(); });
   }
   if (schedules_.empty()) {
@@ -67,6 +175,12 @@ void DispatcherImpl::start() {
 
 void DispatcherImpl::stop() {
   nopaid_scan_running_ = false;
+  running_ = false;
+  stop_signal_.interrupt();
+  // Workers blocked in a request would otherwise wait out its timeout.
+  if (session_) {
+    session_->cancel();
+  }
   pause();
   if (schedule_thread_.joinable()) {
     schedule_thread_.join();
@@ -83,142 +197,179 @@ bool DispatcherImpl::initSession(const SessionConfig &config) {
 
 void DispatcherImpl::cartWorker() {
   spdlog::info("Cart worker started");
+  setThreadName("cart");
   std::random_device rd;
   std::mt19937 ra(rd());
   std::uniform_int_distribution<> dist(10000, 20000);
-  auto sleep_start = std::chrono::steady_clock::time_point::min();
-  uint64_t should_sleep_ms = 0;
+  auto seen = cart_wake_.sequence();
+  auto next_run = std::chrono::steady_clock::now();
   while (running_) {
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
-                        std::chrono::steady_clock::now() - sleep_start)
-                        .count();
-    if (force_order_run_) {
-      force_order_run_ = false;
-      duration = std::numeric_limits<long>::max();
+    cart_wake_.waitUntil(next_run, seen);
+    if (!running_) {
+      break;
     }
-    if (duration >= should_sleep_ms) {
-      if (!session_->cartCheckAll()) {
-        should_sleep_ms = 300;
+    uint64_t should_sleep_ms;
+    TraceSpan refresh("cartRefresh");
+    refresh.setResult(false);
+    TraceSpan check_all("cartCheckAll");
+    auto checked = session_->cartCheckAll();
+    check_all.setResult(checked);
+    check_all.end();
+    if (!checked) {
+      should_sleep_ms = 300;
+    } else {
+      TraceSpan get_cart("getCart");
+      auto got = session_->getCart();
+      get_cart.setResult(got);
+      get_cart.end();
+      if (!got) {
+        should_sleep_ms = dist(ra) - 9000;
       } else {
-        if (!session_->getCart()) {
-          should_sleep_ms = dist(ra) - 9000;
-        } else {
-          should_sleep_ms = dist(ra);
-        }
+        should_sleep_ms = dist(ra);
+        refresh.setResult(true);
+        cart_refreshed_.notify();
       }
-      sleep_start = std::chrono::steady_clock::now();
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    refresh.end();
+    next_run = std::chrono::steady_clock::now() +
+               std::chrono::milliseconds(should_sleep_ms);
   }
   spdlog::info("Cart worker stopped");
 }
 
 void DispatcherImpl::reserveTimeWorker() {
   spdlog::info("Reserve time worker started");
+  setThreadName("reserve_time");
   std::random_device rd;
   std::mt19937 ra(rd());
   std::uniform_int_distribution<> dist(200, 1000);
-  auto sleep_start = std::chrono::steady_clock::time_point::min();
-  uint64_t should_sleep_ms = 0;
+  auto seen = cart_refreshed_.sequence();
+  auto next_run = std::chrono::steady_clock::now();
   while (running_) {
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
-                        std::chrono::steady_clock::now() - sleep_start)
-                        .count();
-    if (duration >= should_sleep_ms) {
-      session_->refreshReserveTime();
-      should_sleep_ms = dist(ra);
-      sleep_start = std::chrono::steady_clock::now();
+    cart_refreshed_.waitUntil(next_run, seen);
+    if (!running_) {
+      break;
+    }
+    TraceSpan refresh("refreshReserveTime");
+    auto published = session_->refreshReserveTime();
+    refresh.setResult(published);
+    refresh.end();
+    if (published) {
+      reserve_time_published_.notify();
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    next_run = std::chrono::steady_clock::now() +
+               std::chrono::milliseconds(dist(ra));
   }
   spdlog::info("Reserve time worker stopped");
 }
 
 void DispatcherImpl::orderWorker(int i) {
-  spdlog::info("Order worker started");
   std::random_device rd;
   std::mt19937 ra(rd());
   std::uniform_int_distribution<> dist(100, 300);
-  auto sleep_start = std::chrono::steady_clock::time_point::min();
-  uint64_t should_sleep_ms = 0;
+  auto seen = reserve_time_published_.sequence();
+  auto next_run = std::chrono::steady_clock::now();
   spdlog::info("Order worker {} started", i);
+  setThreadName("order-" + std::to_string(i));
   while (running_) {
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
-                        std::chrono::steady_clock::now() - sleep_start)
-                        .count();
-    if (duration >= should_sleep_ms) {
-      std::vector<std::pair<uint64_t, uint64_t>> reserve_times;
-      session_->getReserveTime(reserve_times);
-      if (!reserve_times.empty()) {
-        std::uniform_int_distribution<size_t> dist_idx(
-            0, reserve_times.size() - 1);
-        size_t idx = dist_idx(ra);
-        spdlog::debug("Order worker {} trying {} reserve time {}-{}", i, idx,
-                      reserve_times[idx].first, reserve_times[idx].second);
-        ddshop::Order order;
-        int code = -1;
-        if (session_->checkOrder(reserve_times[idx], order, code)) {
-          if (session_->doOrder(order, code)) {
-            spdlog::info("Order worker {} success", i);
-            notify("抢菜成功，抢到" + std::to_string(code) +
-                   "件商品！快去支付！！");
-          } else {
-            if (code == 5001 || code == 5003) {
-              force_order_run_ = true;
-            }
-            spdlog::warn("Order worker {} do order failed", i);
-          }
+    reserve_time_published_.waitUntil(next_run, seen);
+    if (!running_) {
+      break;
+    }
+    auto snapshot = session_->getSnapshot();
+    const auto &reserve_times = snapshot->reserve_time;
+    if (!reserve_times.empty()) {
+      TraceSpan attempt("orderAttempt");
+      TraceSpan pick("getReserveTime");
+      std::uniform_int_distribution<size_t> dist_idx(0,
+                                                     reserve_times.size() - 1);
+      size_t idx = dist_idx(ra);
+      const auto &slot = reserve_times[idx];
+      pick.setSlot(slot);
+      pick.end();
+      attempt.setSlot(slot);
+      SPDLOG_DEBUG("Order worker {} trying {} reserve time {}-{}", i, idx,
+                   slot.first, slot.second);
+      ddshop::Order order;
+      int code = -1;
+      TraceSpan check("checkOrder");
+      check.setSlot(slot);
+      auto checked = session_->checkOrder(snapshot, slot, order, code);
+      check.setCode(code);
+      check.end();
+      if (checked) {
+        TraceSpan submit("doOrder");
+        submit.setSlot(slot);
+        auto done = session_->doOrder(order, code);
+        submit.setCode(code);
+        submit.end();
+        attempt.setResult(done);
+        if (done) {
+          spdlog::info("Order worker {} success", i);
+          notify("抢菜成功，抢到" + std::to_string(code) +
+                 "件商品！快去支付！！");
         } else {
           if (code == 5001 || code == 5003) {
-            force_order_run_ = true;
+            cart_wake_.notify();
           }
-          spdlog::warn("Order worker {} check order failed", i);
+          spdlog::warn("Order worker {} do order failed", i);
         }
+      } else {
+        if (code == 5001 || code == 5003) {
+          cart_wake_.notify();
+        }
+        spdlog::warn("Order worker {} check order failed", i);
       }
-      should_sleep_ms = dist(ra);
-      sleep_start = std::chrono::steady_clock::now();
+      attempt.setCode(code);
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    next_run = std::chrono::steady_clock::now() +
+               std::chrono::milliseconds(dist(ra));
   }
   spdlog::info("Order worker {} stopped", i);
 }
 
 void DispatcherImpl::initBarkNotifier(const std::string &bark_id) {
-  bark_notifier_ = notification::BarkNotifier::makeBarkNotifier(
-      std::forward<const std::string &>(bark_id));
+  notifier_->addSink(notification::BarkNotifier::makeBarkNotifier(
+      bark_id, "https://api.day.app", enableTlsResumption));
+}
+
+void DispatcherImpl::initWebhookNotifier(const std::string &url) {
+  notifier_->addSink(notification::WebhookNotifier::makeWebhookNotifier(
+      url, enableTlsResumption));
 }
 
+void DispatcherImpl::initTrace(const std::string &path) { trace_file_ = path; }
+
 void DispatcherImpl::notify(const std::string &msg) {
-  if (bark_notifier_) {
-    spdlog::info("Sending bark notification {}", msg);
-    bark_notifier_->notify(std::forward<const std::string &>(msg));
-  }
-  if (success_cb_) {
-    success_cb_(std::forward<const std::string &>(msg));
+  spdlog::info("Queueing notification {}", msg);
+  if (!notifier_->post(msg)) {
+    spdlog::warn("Notification queue full, dropped {}", msg);
   }
 }
 
 void DispatcherImpl::unpaidWorker() {
   spdlog::info("Unpaid worker started");
+  setThreadName("unpaid");
   std::random_device rd;
   std::mt19937 ra(rd());
   std::uniform_int_distribution<> dist(55, 65);
-  auto sleep_start = std::chrono::steady_clock::time_point::min();
-  uint64_t should_sleep_ms = 0;
+  auto seen = stop_signal_.sequence();
+  auto next_run = std::chrono::steady_clock::now();
   while (nopaid_scan_running_) {
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
-                        std::chrono::steady_clock::now() - sleep_start)
-                        .count();
-    if (session_ && duration >= should_sleep_ms) {
-      auto unpaid = session_->hasUnpaidOrder();
-      if (unpaid > 0) {
-        notify("您有" + std::to_string(unpaid) +
-               "笔未支付的订单，请前往支付！！");
-      }
-      should_sleep_ms = dist(ra) * 1000;
-      sleep_start = std::chrono::steady_clock::now();
+    stop_signal_.waitUntil(next_run, seen);
+    if (!nopaid_scan_running_) {
+      break;
+    }
+    TraceSpan scan("hasUnpaidOrder");
+    auto unpaid = session_->hasUnpaidOrder();
+    scan.setCode(unpaid);
+    scan.end();
+    if (unpaid > 0) {
+      notify("您有" + std::to_string(unpaid) +
+             "笔未支付的订单，请前往支付！！");
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    next_run =
+        std::chrono::steady_clock::now() + std::chrono::seconds(dist(ra));
   }
   spdlog::info("Unpaid worker stopped");
 }
@@ -226,20 +377,28 @@ void DispatcherImpl::unpaidWorker() {
 void DispatcherImpl::setSchedule(const std::vector<Schedule> &schedules) {
   schedules_ = schedules;
   for (auto &it : schedules) {
-    spdlog::info("Scheduling {:02d}:{:02d} - {:02d}:{:02d}",
-                 it.start_time.first, it.start_time.second, it.stop_time.first,
-                 it.stop_time.second);
+    spdlog::info("Scheduling {}", describeSchedule(it));
+  }
+}
+
+void DispatcherImpl::setWarmup(std::chrono::seconds lead) {
+  warmup_lead_ = lead;
+  if (lead.count() > 0) {
+    spdlog::info("Warming up {}s before each window", lead.count());
   }
 }
 
 void DispatcherImpl::onSuccess(std::function<void(const std::string &)> cb) {
-  success_cb_ = std::move(cb);
+  notifier_->addSink(notification::Sink::makeCallbackSink(std::move(cb)));
 }
 
 void DispatcherImpl::pause() {
   if (running_) {
     running_ = false;
   }
+  cart_wake_.interrupt();
+  cart_refreshed_.interrupt();
+  reserve_time_published_.interrupt();
   if (cart_thread_.joinable()) {
     cart_thread_.join();
   }
@@ -252,28 +411,11 @@ void DispatcherImpl::pause() {
     }
   }
   order_threads_.clear();
-}
-
-bool DispatcherImpl::isTimeInPeriod(const Schedule &schedule) {
-  time_t current_time;
-  struct tm *local_time;
-
-  time(&current_time);
-  local_time = localtime(&current_time);
-
-  auto now_secs = local_time->tm_hour * 3600 + local_time->tm_min * 60;
-  auto start_secs =
-      schedule.start_time.first * 3600 + schedule.start_time.second * 60;
-  auto stop_secs =
-      schedule.stop_time.first * 3600 + schedule.stop_time.second * 60;
-
-  if (start_secs == stop_secs) {
-    spdlog::error("Invalid schedule");
-    return false;
-  } else if (start_secs < stop_secs) {
-    return (now_secs >= start_secs) && (now_secs < stop_secs);
-  } else {
-    return (now_secs >= 0 && now_secs < stop_secs) || (now_secs >= start_secs);
+  if (session_) {
+    session_->logStats();
+  }
+  if (!trace_file_.empty()) {
+    writeChromeTrace(trace_file_);
   }
 }
 
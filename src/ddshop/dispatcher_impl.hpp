@@ -4,7 +4,8 @@
 #include <thread>
 
 #include "ddshop/dispatcher.hpp"
-#include "notification/bark.hpp"
+#include "notification/notifier.hpp"
+#include "stage_signal.hpp"
 
 namespace ddshop {
 
@@ -24,18 +25,33 @@ class DispatcherImpl : public Dispatcher {
 
   void initBarkNotifier(const std::string &) override;
 
+  void initWebhookNotifier(const std::string &url) override;
+
+  void initTrace(const std::string &path) override;
+
   void setSchedule(const std::vector<Schedule> &) override;
 
+  void setWarmup(std::chrono::seconds lead) override;
+
   void onSuccess(std::function<void(const std::string &)>) override;
 
  private:
   const uint8_t ORDER_THREADS_NUM = 2;
+  // Unpaid orders are re-checked every minute; remind at most this often.
+  const std::chrono::minutes NOTIFY_COALESCE_WINDOW{5};
+  const std::chrono::minutes MAX_SLEEP{1};
+  const std::chrono::milliseconds FINAL_SLEEP{5};
+  // A warm-up that left something unready is retried this often.
+  const std::chrono::seconds WARMUP_RETRY{5};
 
   std::shared_ptr<Session> session_;
-  std::shared_ptr<notification::BarkNotifier> bark_notifier_;
+  std::shared_ptr<notification::Notifier> notifier_;
   std::atomic<bool> running_;
   std::atomic<bool> nopaid_scan_running_;
-  std::atomic<bool> force_order_run_;
+  StageSignal cart_wake_;
+  StageSignal cart_refreshed_;
+  StageSignal reserve_time_published_;
+  StageSignal stop_signal_;
   std::thread cart_thread_;
   std::thread reserve_time_thread_;
   std::vector<std::thread> order_threads_;
@@ -43,19 +59,33 @@ class DispatcherImpl : public Dispatcher {
   std::thread schedule_thread_;
 
   std::vector<Schedule> schedules_;
+  std::string trace_file_;
 
-  std::function<void(const std::string &)> success_cb_;
+  std::chrono::seconds warmup_lead_{0};
+  // Only touched by the scheduler thread. Set once a warm-up for the coming
+  // window got everything ready and cleared when the window ends.
+  bool warmed_up_ = false;
+  std::atomic<bool> warmup_ready_{false};
+  std::atomic<size_t> warmup_connections_{0};
+  std::atomic<uint64_t> warmup_ns_{0};
+  size_t metrics_collector_;
 
   void cartWorker();
   void reserveTimeWorker();
   void orderWorker(int i);
   void unpaidWorker();
   void scheduleWorker();
+  // Returns whether everything got ready.
+  bool warmUp(int seconds_to_start);
 
   void spawn();
   void pause();
 
-  static bool isTimeInPeriod(const Schedule &schedule);
+  // Sleeps until the server clock reaches deadline. Returns false if
+  // stopped first.
+  bool sleepUntil(std::chrono::system_clock::time_point deadline,
+                  uint64_t &seen);
+  static double msSince(std::chrono::system_clock::time_point t);
 
   void notify(const std::string &);
 };
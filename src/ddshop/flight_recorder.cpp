@@ -0,0 +1,200 @@
+#include "flight_recorder.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+#include "thread_registry.hpp"
+
+namespace ddshop {
+
+namespace {
+
+const size_t MAX_BODY = 64 * 1024;
+const size_t MAX_REQUEST_LINE = 4 * 1024;
+
+struct Settings {
+  std::mutex mutex;
+  std::string dir;
+  size_t ring_bytes = 0;
+};
+
+// Leaked like the rings, see ThreadRegistry.
+Settings &settings() {
+  static auto instance = new Settings;
+  return *instance;
+}
+
+std::atomic<bool> recorder_open{false};
+
+// Created once the recorder is open, header stays null if mapping failed.
+struct Ring {
+  explicit Ring(std::string name) : name(std::move(name)) { map(); }
+
+  const std::string name;
+  std::mutex mutex;
+  FlightFileHeader *header = nullptr;
+  char *data = nullptr;
+  uint64_t capacity = 0;
+
+  void write(uint64_t pos, const void *src, size_t len) {
+    auto off = pos % capacity;
+    auto first = std::min<uint64_t>(len, capacity - off);
+    memcpy(data + off, src, first);
+    memcpy(data, static_cast<const char *>(src) + first, len - first);
+  }
+
+  // Keeps appending to an existing ring of the same size, so the history of
+  // an earlier run is only overwritten as the new one fills the ring.
+  void map() {
+    std::string dir;
+    size_t ring_bytes;
+    {
+      auto &config = settings();
+      std::lock_guard<std::mutex> lck(config.mutex);
+      dir = config.dir;
+      ring_bytes = config.ring_bytes;
+    }
+    auto path = dir + "/" + name + ".ring";
+    auto file_size = sizeof(FlightFileHeader) + ring_bytes;
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+      spdlog::error("Failed to open flight recorder file {}", path);
+      return;
+    }
+    struct stat st {};
+    bool reuse = fstat(fd, &st) == 0 &&
+                 static_cast<size_t>(st.st_size) == file_size;
+    if (!reuse && ftruncate(fd, file_size) != 0) {
+      spdlog::error("Failed to size flight recorder file {}", path);
+      ::close(fd);
+      return;
+    }
+    auto addr =
+        mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED) {
+      spdlog::error("Failed to map flight recorder file {}", path);
+      return;
+    }
+    auto mapped = static_cast<FlightFileHeader *>(addr);
+    if (!reuse || memcmp(mapped->magic, FLIGHT_FILE_MAGIC, 8) != 0 ||
+        mapped->version != FLIGHT_FILE_VERSION ||
+        mapped->capacity != ring_bytes) {
+      memset(mapped, 0, sizeof(FlightFileHeader));
+      mapped->version = FLIGHT_FILE_VERSION;
+      mapped->header_size = sizeof(FlightFileHeader);
+      mapped->capacity = ring_bytes;
+      strncpy(mapped->worker, name.c_str(), sizeof(mapped->worker) - 1);
+      memcpy(mapped->magic, FLIGHT_FILE_MAGIC, 8);
+    }
+    // A record the last run did not finish is dropped.
+    mapped->reserved = mapped->head;
+    data = static_cast<char *>(addr) + sizeof(FlightFileHeader);
+    capacity = ring_bytes;
+    header = mapped;
+    spdlog::info("Recording {} requests to {}", name, path);
+  }
+};
+
+struct Piece {
+  const char *data;
+  size_t len;
+};
+
+}  // namespace
+
+bool openFlightRecorder(const std::string &dir, size_t ring_bytes) {
+  auto &config = settings();
+  std::lock_guard<std::mutex> lck(config.mutex);
+  if (recorder_open) {
+    return true;
+  }
+  // Records are 8-byte aligned and must fit several times over.
+  if (ring_bytes < 1024 * 1024 || ring_bytes % 8 != 0) {
+    spdlog::error("Invalid flight recorder size {}", ring_bytes);
+    return false;
+  }
+  config.dir = dir;
+  config.ring_bytes = ring_bytes;
+  recorder_open = true;
+  // Opening, sizing and mapping the file happen when a worker is named, not
+  // on its first exchange in the middle of the order path.
+  addThreadNameHook([]() { ThreadRegistry<Ring>::instance().current(); });
+  return true;
+}
+
+void recordExchange(Endpoint endpoint, uint64_t dur_ns,
+                    const httplib::Request &req, const httplib::Result &res) {
+  if (!recorder_open.load(std::memory_order_relaxed)) {
+    return;
+  }
+  auto &ring = ThreadRegistry<Ring>::instance().current();
+  if (!ring.header) {
+    return;
+  }
+  auto max_body = std::min<size_t>(MAX_BODY, ring.capacity / 8);
+
+  Piece request[] = {
+      {req.method.data(), req.method.size()},
+      {" ", 1},
+      {req.path.data(), std::min(req.path.size(), MAX_REQUEST_LINE)},
+      {"\n", 1},
+      {req.body.data(), std::min(req.body.size(), max_body)}};
+  Piece response = {"", 0};
+  if (res) {
+    response = {res->body.data(), std::min(res->body.size(), max_body)};
+  }
+
+  FlightRecord record{};
+  record.magic = FLIGHT_RECORD_MAGIC;
+  for (auto &it : request) {
+    record.request_len += it.len;
+  }
+  record.response_len = response.len;
+  auto unpadded =
+      sizeof(FlightRecord) + record.request_len + record.response_len;
+  auto padding = (8 - unpadded % 8) % 8;
+  record.size = unpadded + padding + sizeof(FlightTrailer);
+  record.dur_ns = dur_ns;
+  record.wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::system_clock::now().time_since_epoch())
+                       .count() -
+                   dur_ns;
+  record.endpoint = static_cast<uint16_t>(endpoint);
+  record.error = static_cast<uint16_t>(res.error());
+  record.status = res ? res->status : -1;
+  FlightTrailer trailer{record.size, FLIGHT_RECORD_MAGIC};
+  static const char ZEROS[8] = {};
+
+  std::lock_guard<std::mutex> lck(ring.mutex);
+  auto header = ring.header;
+  auto pos = header->head;
+  header->reserved = pos + record.size;
+  std::atomic_thread_fence(std::memory_order_release);
+  ring.write(pos, &record, sizeof(record));
+  pos += sizeof(record);
+  for (auto &it : request) {
+    ring.write(pos, it.data, it.len);
+    pos += it.len;
+  }
+  ring.write(pos, response.data, response.len);
+  pos += response.len;
+  ring.write(pos, ZEROS, padding);
+  pos += padding;
+  ring.write(pos, &trailer, sizeof(trailer));
+  pos += sizeof(trailer);
+  std::atomic_thread_fence(std::memory_order_release);
+  header->head = pos;
+}
+
+}  // namespace ddshop
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "httplib.h"
+#include "metrics.hpp"
+
+namespace ddshop {
+
+// On-disk layout of a ring file, shared with tools/flight_decode.
+//
+// The data area after the header is a byte ring. Each record is a
+// FlightRecord, the request line ("METHOD path\n") and body, the response
+// body, zero padding to 8 bytes and a FlightTrailer, so readers walk back
+// from head using the trailers.
+const char FLIGHT_FILE_MAGIC[8] = {'D', 'D', 'F', 'L', 'I', 'G', 'H', 'T'};
+const uint32_t FLIGHT_FILE_VERSION = 1;
+const uint32_t FLIGHT_RECORD_MAGIC = 0x52464444;  // "DDFR"
+
+struct FlightFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t capacity;
+  // Bytes ever written, the newest record ends at head % capacity.
+  uint64_t head;
+  // End of the record being written. Bytes before reserved - capacity may
+  // have been overwritten if the writer died mid-record.
+  uint64_t reserved;
+  char worker[32];
+};
+
+struct FlightRecord {
+  uint32_t magic;
+  // Of the whole record including padding and trailer.
+  uint32_t size;
+  int64_t wall_ns;
+  uint64_t dur_ns;
+  uint16_t endpoint;
+  uint16_t error;
+  int32_t status;
+  uint32_t request_len;
+  uint32_t response_len;
+};
+
+struct FlightTrailer {
+  uint32_t size;
+  uint32_t magic;
+};
+
+// Maps one ring file of ring_bytes per thread name, see setThreadName(),
+// into dir. Threads named after this call map theirs as they are named,
+// others on their first exchange. Recording is a memcpy into the shared
+// mapping; the kernel writes the pages back, so the data survives the
+// process being killed. Only the first call has effect.
+bool openFlightRecorder(const std::string &dir, size_t ring_bytes);
+
+// No-op unless the recorder is open. Bodies are truncated to a fraction of
+// the ring so one record never evicts the whole history.
+void recordExchange(Endpoint endpoint, uint64_t dur_ns,
+                    const httplib::Request &req, const httplib::Result &res);
+
+}  // namespace ddshop
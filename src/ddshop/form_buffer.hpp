@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace ddshop {
+
+// Returns this thread's request buffer, reset to prefix. The buffer keeps
+// its capacity between requests, so building a query or form body only
+// allocates while it is still growing.
+inline std::string &formBuffer(const std::string &prefix) {
+  static thread_local std::string buffer;
+  buffer.assign(prefix);
+  return buffer;
+}
+
+inline std::string &formBuffer(const char *path, const std::string &query) {
+  static thread_local std::string buffer;
+  buffer.assign(path).append("?").append(query);
+  return buffer;
+}
+
+inline std::string &appendNumber(std::string &out, uint64_t value) {
+  char digits[20];
+  size_t len = 0;
+  do {
+    digits[len++] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value);
+  while (len) {
+    out.push_back(digits[--len]);
+  }
+  return out;
+}
+
+}  // namespace ddshop
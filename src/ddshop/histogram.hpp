@@ -0,0 +1,110 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace ddshop {
+
+// Log-linear latency histogram in microseconds: exact below 8 us, then 8
+// sub-buckets per power of two (12.5% resolution) up to ~67 s. Recording is
+// three relaxed atomic adds.
+class LatencyHistogram {
+ public:
+  static const size_t SUB_BITS = 3;
+  static const size_t SUB_COUNT = 1 << SUB_BITS;
+  static const size_t MAX_EXP = 25;
+  static const size_t BUCKETS = (MAX_EXP - SUB_BITS + 2) * SUB_COUNT;
+
+  void record(uint64_t ns) {
+    buckets_[bucketOf(ns / 1000)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+  }
+
+  static size_t bucketOf(uint64_t us) {
+    if (us < SUB_COUNT) {
+      return us;
+    }
+    size_t exp = 63 - __builtin_clzll(us);
+    if (exp > MAX_EXP) {
+      return BUCKETS - 1;
+    }
+    auto sub = (us >> (exp - SUB_BITS)) & (SUB_COUNT - 1);
+    return (exp - SUB_BITS + 1) * SUB_COUNT + sub;
+  }
+
+  // Exclusive upper bound of a bucket in microseconds.
+  static uint64_t upperBound(size_t bucket) {
+    if (bucket < SUB_COUNT) {
+      return bucket + 1;
+    }
+    auto exp = bucket / SUB_COUNT + SUB_BITS - 1;
+    auto sub = bucket % SUB_COUNT;
+    return (SUB_COUNT + sub + 1) << (exp - SUB_BITS);
+  }
+
+ private:
+  friend struct HistogramData;
+
+  std::array<std::atomic<uint64_t>, BUCKETS> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_ns_{0};
+};
+
+// A plain copy of one or more histograms, taken when scraping.
+struct HistogramData {
+  std::array<uint64_t, LatencyHistogram::BUCKETS> buckets{};
+  uint64_t count = 0;
+  uint64_t sum_ns = 0;
+
+  void merge(const LatencyHistogram &hist) {
+    for (size_t i = 0; i < buckets.size(); ++i) {
+      buckets[i] += hist.buckets_[i].load(std::memory_order_relaxed);
+    }
+    count += hist.count_.load(std::memory_order_relaxed);
+    sum_ns += hist.sum_ns_.load(std::memory_order_relaxed);
+  }
+
+  void merge(const HistogramData &other) {
+    for (size_t i = 0; i < buckets.size(); ++i) {
+      buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    sum_ns += other.sum_ns;
+  }
+
+  // Upper bound in microseconds of the bucket holding quantile q.
+  uint64_t quantile(double q) const {
+    uint64_t total = 0;
+    for (auto it : buckets) {
+      total += it;
+    }
+    if (total == 0) {
+      return 0;
+    }
+    auto rank = static_cast<uint64_t>(q * (total - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+      seen += buckets[i];
+      if (seen >= rank) {
+        return LatencyHistogram::upperBound(i);
+      }
+    }
+    return LatencyHistogram::upperBound(buckets.size() - 1);
+  }
+
+  // Observations below le_us, for Prometheus cumulative buckets.
+  uint64_t countBelow(uint64_t le_us) const {
+    uint64_t ret = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+      if (LatencyHistogram::upperBound(i) > le_us) {
+        break;
+      }
+      ret += buckets[i];
+    }
+    return ret;
+  }
+};
+
+}  // namespace ddshop
@@ -0,0 +1,324 @@
+#include "ddshop/logging.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "metrics.hpp"
+#include "spdlog/async.h"
+#include "spdlog/async_logger.h"
+#include "spdlog/sinks/sink.h"
+#include "thread_registry.hpp"
+
+namespace ddshop {
+
+namespace {
+
+// Fits every regular message; bodies and other payloads are cut here.
+const size_t MAX_PAYLOAD = 480;
+const size_t RING_SLOTS = 512;
+const auto DRAIN_INTERVAL = std::chrono::milliseconds(2);
+const auto FLUSH_INTERVAL = std::chrono::seconds(1);
+const auto DROP_REPORT_INTERVAL = std::chrono::seconds(1);
+
+struct Slot {
+  spdlog::log_clock::time_point time;
+  size_t thread_id;
+  spdlog::level::level_enum level;
+  size_t len;
+  char payload[MAX_PAYLOAD];
+};
+
+// Written by the owning thread only and read by the writer only.
+struct Ring {
+  std::atomic<uint64_t> head{0};
+  std::atomic<uint64_t> tail{0};
+  std::atomic<uint64_t> dropped{0};
+  // Set when the owning thread exits; the ring is reused once drained.
+  std::atomic<bool> released{false};
+  Slot slots[RING_SLOTS];
+};
+
+// Hands the ring back when its thread exits.
+struct RingLease {
+  Ring *ring = nullptr;
+  ~RingLease() {
+    if (ring) {
+      ring->released = true;
+    }
+  }
+};
+
+thread_local RingLease current_ring;
+
+// Cuts payloads longer than MAX_PAYLOAD on a UTF-8 boundary and notes the
+// original size.
+size_t copyPayload(spdlog::string_view_t payload, char *out) {
+  if (payload.size() <= MAX_PAYLOAD) {
+    memcpy(out, payload.data(), payload.size());
+    return payload.size();
+  }
+  char suffix[32];
+  size_t suffix_len = snprintf(suffix, sizeof(suffix), "...(%zu bytes)",
+                               payload.size());
+  auto keep = MAX_PAYLOAD - suffix_len;
+  while (keep > 0 && (payload[keep] & 0xC0) == 0x80) {
+    --keep;
+  }
+  memcpy(out, payload.data(), keep);
+  memcpy(out + keep, suffix, suffix_len);
+  return keep + suffix_len;
+}
+
+// Drains the rings of all threads into the sinks in time order from one
+// thread. Shared by every HOT_PATH logger, so replacing the logger never
+// leaves two consumers on a ring.
+class Writer {
+ public:
+  Ring *acquire() {
+    return &rings().find(
+        [](Ring &it) {
+          if (it.released && it.tail == it.head) {
+            it.released = false;
+            return true;
+          }
+          return false;
+        },
+        []() { return new Ring; });
+  }
+
+  uint64_t dropped() {
+    uint64_t total = 0;
+    rings().forEach([&total](Ring &it) {
+      total += it.dropped.load(std::memory_order_relaxed);
+    });
+    return total;
+  }
+
+  void attach(std::vector<spdlog::sink_ptr> sinks) {
+    std::lock_guard<std::mutex> lck(mutex_);
+    sinks_ = std::move(sinks);
+    if (users_++ == 0) {
+      stopping_ = false;
+      thread_ = std::thread([this]() { run(); });
+    }
+  }
+
+  // The last user stops the writer after draining what is left.
+  void detach() {
+    std::unique_lock<std::mutex> lck(mutex_);
+    if (--users_ != 0) {
+      return;
+    }
+    stopping_ = true;
+    lck.unlock();
+    cv_.notify_one();
+    thread_.join();
+    drain(true);
+  }
+
+  void requestFlush() { flush_requested_ = true; }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<spdlog::sink_ptr> sinks_;
+  size_t users_ = 0;
+  bool stopping_ = false;
+  std::thread thread_;
+  std::atomic<bool> flush_requested_{false};
+
+  // Only touched by the draining thread.
+  uint64_t reported_dropped_ = 0;
+  spdlog::log_clock::time_point last_flush_;
+  spdlog::log_clock::time_point last_drop_report_;
+  std::vector<const Slot *> batch_;
+  std::vector<std::pair<Ring *, uint64_t>> heads_;
+
+  static ThreadRegistry<Ring> &rings() {
+    return ThreadRegistry<Ring>::instance();
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lck(mutex_);
+    while (!stopping_) {
+      lck.unlock();
+      bool idle = !drain(false);
+      lck.lock();
+      if (idle) {
+        cv_.wait_for(lck, DRAIN_INTERVAL);
+      }
+    }
+  }
+
+  static void write(const std::vector<spdlog::sink_ptr> &sinks,
+                    const spdlog::details::log_msg &msg) {
+    for (auto &sink : sinks) {
+      if (sink->should_log(msg.level)) {
+        // A failing sink must not take the writer down.
+        try {
+          sink->log(msg);
+        } catch (...) {
+        }
+      }
+    }
+  }
+
+  // Returns false if there was nothing to write. final is set for the last
+  // drain before the writer stops.
+  bool drain(bool final) {
+    auto flush = final;
+    std::vector<spdlog::sink_ptr> sinks;
+    {
+      std::lock_guard<std::mutex> lck(mutex_);
+      sinks = sinks_;
+    }
+    batch_.clear();
+    heads_.clear();
+    rings().forEach([this](Ring &it) {
+      auto tail = it.tail.load(std::memory_order_relaxed);
+      auto head = it.head.load(std::memory_order_acquire);
+      for (auto i = tail; i < head; ++i) {
+        batch_.push_back(&it.slots[i % RING_SLOTS]);
+      }
+      if (head != tail) {
+        heads_.emplace_back(&it, head);
+      }
+    });
+    std::stable_sort(batch_.begin(), batch_.end(),
+                     [](const Slot *a, const Slot *b) {
+                       return a->time < b->time;
+                     });
+    for (auto slot : batch_) {
+      spdlog::details::log_msg msg(
+          slot->time, spdlog::source_loc{}, "ddshop", slot->level,
+          spdlog::string_view_t(slot->payload, slot->len));
+      msg.thread_id = slot->thread_id;
+      write(sinks, msg);
+      flush = flush || slot->level >= spdlog::level::warn;
+    }
+    for (auto &it : heads_) {
+      it.first->tail.store(it.second, std::memory_order_release);
+    }
+
+    auto now = spdlog::log_clock::now();
+    auto dropped_total = dropped();
+    if (dropped_total != reported_dropped_ &&
+        (final || now - last_drop_report_ >= DROP_REPORT_INTERVAL)) {
+      auto text = fmt::format("Dropped {} log messages",
+                              dropped_total - reported_dropped_);
+      reported_dropped_ = dropped_total;
+      last_drop_report_ = now;
+      write(sinks, spdlog::details::log_msg("ddshop", spdlog::level::warn,
+                                            text));
+      flush = true;
+    }
+
+    if (flush || flush_requested_.exchange(false) ||
+        (!batch_.empty() && now - last_flush_ >= FLUSH_INTERVAL)) {
+      for (auto &sink : sinks) {
+        try {
+          sink->flush();
+        } catch (...) {
+        }
+      }
+      last_flush_ = now;
+    }
+    return !batch_.empty();
+  }
+};
+
+// Leaked like the rings, see ThreadRegistry.
+Writer &writer() {
+  static auto instance = new Writer;
+  return *instance;
+}
+
+// Copies the formatted message into the calling thread's ring. Never
+// blocks and never allocates.
+class RingSink : public spdlog::sinks::sink {
+ public:
+  explicit RingSink(std::vector<spdlog::sink_ptr> sinks) : sinks_(sinks) {
+    writer().attach(std::move(sinks));
+  }
+
+  ~RingSink() override { writer().detach(); }
+
+  void log(const spdlog::details::log_msg &msg) override {
+    if (!current_ring.ring) {
+      current_ring.ring = writer().acquire();
+    }
+    auto &ring = *current_ring.ring;
+    auto head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) == RING_SLOTS) {
+      ring.dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    auto &slot = ring.slots[head % RING_SLOTS];
+    slot.time = msg.time;
+    slot.thread_id = msg.thread_id;
+    slot.level = msg.level;
+    slot.len = copyPayload(msg.payload, slot.payload);
+    ring.head.store(head + 1, std::memory_order_release);
+  }
+
+  void flush() override { writer().requestFlush(); }
+
+  void set_pattern(const std::string &pattern) override {
+    for (auto &it : sinks_) {
+      it->set_pattern(pattern);
+    }
+  }
+
+  void set_formatter(std::unique_ptr<spdlog::formatter> formatter) override {
+    for (auto &it : sinks_) {
+      it->set_formatter(formatter->clone());
+    }
+  }
+
+ private:
+  const std::vector<spdlog::sink_ptr> sinks_;
+};
+
+}  // namespace
+
+void setupLogging(const std::vector<spdlog::sink_ptr> &sinks,
+                  LogProfile profile) {
+  std::shared_ptr<spdlog::logger> logger;
+  if (profile == LogProfile::HOT_PATH) {
+    logger = std::make_shared<spdlog::logger>(
+        "ddshop", std::make_shared<RingSink>(sinks));
+  } else {
+    spdlog::init_thread_pool(1024, 1);
+    logger = std::make_shared<spdlog::async_logger>(
+        "ddshop", sinks.begin(), sinks.end(), spdlog::thread_pool(),
+        spdlog::async_overflow_policy::block);
+  }
+  logger->set_level(spdlog::level::debug);
+  spdlog::set_default_logger(logger);
+
+  static std::once_flag collector;
+  std::call_once(collector, []() {
+    addMetricsCollector([](std::string &out) {
+      out.append(
+             "# HELP ddshop_log_dropped_total Log messages dropped by the "
+             "hot path logging profile.\n"
+             "# TYPE ddshop_log_dropped_total counter\n"
+             "ddshop_log_dropped_total ")
+          .append(std::to_string(droppedLogMessages()))
+          .append("\n");
+    });
+  });
+}
+
+uint64_t droppedLogMessages() { return writer().dropped(); }
+
+std::string logThreadName(size_t thread_id) {
+  return threadNameOf(thread_id);
+}
+
+}  // namespace ddshop
@@ -0,0 +1,376 @@
+#include "metrics.hpp"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+#include "thread_registry.hpp"
+
+namespace ddshop {
+
+namespace {
+
+const size_t ENDPOINT_NUM = static_cast<size_t>(Endpoint::COUNT);
+const size_t OUTCOME_NUM = static_cast<size_t>(Outcome::COUNT);
+const size_t PHASE_NUM = RequestPhases::COUNT;
+
+// Prometheus bucket bounds in microseconds.
+const uint64_t EXPORT_BOUNDS_US[] = {5000,   10000,   25000,   50000,
+                                     100000, 250000,  500000,  1000000,
+                                     2500000, 5000000, 10000000};
+
+struct Shard {
+  explicit Shard(std::string name) : name(std::move(name)) {}
+
+  const std::string name;
+  LatencyHistogram latency[ENDPOINT_NUM][OUTCOME_NUM];
+  LatencyHistogram phases[ENDPOINT_NUM][PHASE_NUM];
+  // Threads sharing a name write concurrently, as with the histograms.
+  struct {
+    std::atomic<uint64_t> responses{0};
+    std::atomic<uint64_t> compressed{0};
+    std::atomic<uint64_t> wire_bytes{0};
+    std::atomic<uint64_t> body_bytes{0};
+    std::atomic<uint64_t> decode_ns{0};
+  } bodies[ENDPOINT_NUM];
+};
+
+using ShardRegistry = ThreadRegistry<Shard>;
+
+struct Collectors {
+  std::mutex mutex;
+  std::map<size_t, MetricsCollector> collectors;
+  size_t next_id = 1;
+};
+
+// Leaked like the shards, collectors may be removed during static
+// destruction.
+Collectors &collectors() {
+  static auto instance = new Collectors;
+  return *instance;
+}
+
+std::atomic<uint64_t> slow_request_ns{1000000000};
+
+Shard &currentShard() { return ShardRegistry::instance().current(); }
+
+void appendSeconds(std::string &out, uint64_t us) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.9g", static_cast<double>(us) / 1e6);
+  out.append(buf);
+}
+
+void appendHistogram(std::string &out, const char *name,
+                     const std::string &labels, const HistogramData &data) {
+  // Derived from the buckets so +Inf is never below a finite bucket while
+  // recording races with the scrape.
+  auto count = std::to_string(data.countBelow(UINT64_MAX));
+  for (auto bound : EXPORT_BOUNDS_US) {
+    out.append(name).append("_bucket{").append(labels).append(",le=\"");
+    appendSeconds(out, bound);
+    out.append("\"} ")
+        .append(std::to_string(data.countBelow(bound)))
+        .append("\n");
+  }
+  out.append(name)
+      .append("_bucket{")
+      .append(labels)
+      .append(",le=\"+Inf\"} ")
+      .append(count)
+      .append("\n");
+  out.append(name).append("_sum{").append(labels).append("} ");
+  appendSeconds(out, data.sum_ns / 1000);
+  out.append("\n");
+  out.append(name)
+      .append("_count{")
+      .append(labels)
+      .append("} ")
+      .append(count)
+      .append("\n");
+}
+
+}  // namespace
+
+const char *endpointName(Endpoint endpoint) {
+  switch (endpoint) {
+    case Endpoint::USER_DETAIL:
+      return "user_detail";
+    case Endpoint::USER_ADDRESS:
+      return "user_address";
+    case Endpoint::CART_CHECK_ALL:
+      return "cart_check_all";
+    case Endpoint::CART_INDEX:
+      return "cart_index";
+    case Endpoint::RESERVE_TIME:
+      return "get_multi_reserve_time";
+    case Endpoint::CHECK_ORDER:
+      return "check_order";
+    case Endpoint::ADD_NEW_ORDER:
+      return "add_new_order";
+    case Endpoint::NOT_PAY_LIST:
+      return "not_pay_list";
+    default:
+      return "unknown";
+  }
+}
+
+const char *outcomeName(Outcome outcome) {
+  switch (outcome) {
+    case Outcome::OK:
+      return "ok";
+    case Outcome::TRANSPORT_ERROR:
+      return "transport_error";
+    case Outcome::JSON_ERROR:
+      return "json_error";
+    case Outcome::CODE_5001:
+      return "code_5001";
+    case Outcome::CODE_5003:
+      return "code_5003";
+    case Outcome::CODE_5004:
+      return "code_5004";
+    default:
+      return "code_other";
+  }
+}
+
+Outcome outcomeOfCode(int64_t code) {
+  switch (code) {
+    case 0:
+      return Outcome::OK;
+    case 5001:
+      return Outcome::CODE_5001;
+    case 5003:
+      return Outcome::CODE_5003;
+    case 5004:
+      return Outcome::CODE_5004;
+    default:
+      return Outcome::CODE_OTHER;
+  }
+}
+
+void recordRequest(Endpoint endpoint, Outcome outcome, uint64_t ns,
+                   const RequestPhases *phases) {
+  auto &shard = currentShard();
+  auto e = static_cast<size_t>(endpoint);
+  shard.latency[e][static_cast<size_t>(outcome)].record(ns);
+  if (!phases || phases->acquired == RequestPhases::TimePoint()) {
+    return;
+  }
+  uint64_t phase_ns[PHASE_NUM];
+  bool happened[PHASE_NUM];
+  phases->durations(phase_ns, happened);
+  for (size_t i = 0; i < PHASE_NUM; ++i) {
+    if (happened[i]) {
+      shard.phases[e][i].record(phase_ns[i]);
+    }
+  }
+  if (phases->first_byte != RequestPhases::TimePoint()) {
+    auto &body = shard.bodies[e];
+    body.responses.fetch_add(1, std::memory_order_relaxed);
+    body.compressed.fetch_add(phases->compressed, std::memory_order_relaxed);
+    body.wire_bytes.fetch_add(phases->wire_bytes, std::memory_order_relaxed);
+    body.body_bytes.fetch_add(phases->body_bytes, std::memory_order_relaxed);
+    body.decode_ns.fetch_add(phases->decode_ns, std::memory_order_relaxed);
+  }
+  if (ns >= slow_request_ns.load(std::memory_order_relaxed)) {
+    spdlog::warn("Slow {} ({}) took {:.1f}ms: {}", endpointName(endpoint),
+                 outcomeName(outcome), ns / 1e6, phases->describe());
+  }
+}
+
+void setSlowRequestThreshold(std::chrono::milliseconds threshold) {
+  slow_request_ns.store(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(threshold).count(),
+      std::memory_order_relaxed);
+}
+
+const char *phaseName(Phase phase) {
+  switch (phase) {
+    case Phase::QUEUE:
+      return "queue";
+    case Phase::DNS:
+      return "dns";
+    case Phase::CONNECT:
+      return "connect";
+    case Phase::TLS:
+      return "tls";
+    case Phase::TTFB:
+      return "ttfb";
+    case Phase::BODY:
+      return "body";
+    default:
+      return "unknown";
+  }
+}
+
+std::string RequestPhases::describe() const {
+  uint64_t ns[COUNT];
+  bool happened[COUNT];
+  durations(ns, happened);
+  std::string ret;
+  char buf[48];
+  for (size_t i = 0; i < COUNT; ++i) {
+    if (!happened[i]) {
+      continue;
+    }
+    snprintf(buf, sizeof(buf), "%s%s %.1fms", ret.empty() ? "" : " ",
+             phaseName(static_cast<Phase>(i)), ns[i] / 1e6);
+    ret.append(buf);
+  }
+  if (dns_done == TimePoint()) {
+    ret.append(" (reused connection)");
+  }
+  return ret;
+}
+
+HistogramData requestLatency(Endpoint endpoint) {
+  HistogramData ret;
+  ShardRegistry::instance().forEach([&ret, endpoint](Shard &shard) {
+    for (auto &it : shard.latency[static_cast<size_t>(endpoint)]) {
+      ret.merge(it);
+    }
+  });
+  return ret;
+}
+
+BodyStats responseBodies(Endpoint endpoint) {
+  BodyStats ret;
+  ShardRegistry::instance().forEach([&ret, endpoint](Shard &shard) {
+    auto &body = shard.bodies[static_cast<size_t>(endpoint)];
+    ret.responses += body.responses.load(std::memory_order_relaxed);
+    ret.compressed += body.compressed.load(std::memory_order_relaxed);
+    ret.wire_bytes += body.wire_bytes.load(std::memory_order_relaxed);
+    ret.body_bytes += body.body_bytes.load(std::memory_order_relaxed);
+    ret.decode_ns += body.decode_ns.load(std::memory_order_relaxed);
+  });
+  return ret;
+}
+
+size_t addMetricsCollector(MetricsCollector collector) {
+  auto &reg = collectors();
+  std::lock_guard<std::mutex> lck(reg.mutex);
+  auto id = reg.next_id++;
+  reg.collectors.emplace(id, std::move(collector));
+  return id;
+}
+
+void removeMetricsCollector(size_t id) {
+  auto &reg = collectors();
+  std::lock_guard<std::mutex> lck(reg.mutex);
+  reg.collectors.erase(id);
+}
+
+std::string renderMetrics() {
+  // Shards are never freed, so they can be read after the lock is dropped.
+  std::vector<Shard *> shards;
+  ShardRegistry::instance().forEach(
+      [&shards](Shard &shard) { shards.push_back(&shard); });
+  std::string out;
+  out.append(
+      "# HELP ddshop_request_duration_seconds Latency of ddxq API calls.\n"
+      "# TYPE ddshop_request_duration_seconds histogram\n");
+  for (auto shard : shards) {
+    for (size_t e = 0; e < ENDPOINT_NUM; ++e) {
+      for (size_t o = 0; o < OUTCOME_NUM; ++o) {
+        HistogramData data;
+        data.merge(shard->latency[e][o]);
+        if (data.count == 0) {
+          continue;
+        }
+        std::string labels = "endpoint=\"";
+        labels.append(endpointName(static_cast<Endpoint>(e)));
+        labels.append("\",outcome=\"");
+        labels.append(outcomeName(static_cast<Outcome>(o)));
+        labels.append("\",worker=\"").append(shard->name).append("\"");
+        appendHistogram(out, "ddshop_request_duration_seconds", labels, data);
+      }
+    }
+  }
+
+  out.append(
+      "# HELP ddshop_request_phase_seconds Time spent per request phase.\n"
+      "# TYPE ddshop_request_phase_seconds histogram\n");
+  for (size_t e = 0; e < ENDPOINT_NUM; ++e) {
+    for (size_t p = 0; p < PHASE_NUM; ++p) {
+      HistogramData data;
+      for (auto shard : shards) {
+        data.merge(shard->phases[e][p]);
+      }
+      if (data.count == 0) {
+        continue;
+      }
+      std::string labels = "endpoint=\"";
+      labels.append(endpointName(static_cast<Endpoint>(e)));
+      labels.append("\",phase=\"");
+      labels.append(phaseName(static_cast<Phase>(p)));
+      labels.append("\"");
+      appendHistogram(out, "ddshop_request_phase_seconds", labels, data);
+    }
+  }
+
+  std::string compressed;
+  std::string bytes;
+  std::string decode;
+  for (size_t e = 0; e < ENDPOINT_NUM; ++e) {
+    BodyStats body;
+    for (auto shard : shards) {
+      auto &it = shard->bodies[e];
+      body.responses += it.responses.load(std::memory_order_relaxed);
+      body.compressed += it.compressed.load(std::memory_order_relaxed);
+      body.wire_bytes += it.wire_bytes.load(std::memory_order_relaxed);
+      body.body_bytes += it.body_bytes.load(std::memory_order_relaxed);
+      body.decode_ns += it.decode_ns.load(std::memory_order_relaxed);
+    }
+    if (body.responses == 0) {
+      continue;
+    }
+    std::string labels = "{endpoint=\"";
+    labels.append(endpointName(static_cast<Endpoint>(e)));
+    compressed.append("ddshop_compressed_responses_total")
+        .append(labels)
+        .append("\"} ")
+        .append(std::to_string(body.compressed))
+        .append("\n");
+    bytes.append("ddshop_response_bytes_total")
+        .append(labels)
+        .append("\",form=\"wire\"} ")
+        .append(std::to_string(body.wire_bytes))
+        .append("\n");
+    bytes.append("ddshop_response_bytes_total")
+        .append(labels)
+        .append("\",form=\"decoded\"} ")
+        .append(std::to_string(body.body_bytes))
+        .append("\n");
+    decode.append("ddshop_response_decode_seconds_total")
+        .append(labels)
+        .append("\"} ");
+    appendSeconds(decode, body.decode_ns / 1000);
+    decode.append("\n");
+  }
+  out.append(
+         "# HELP ddshop_compressed_responses_total Responses that arrived "
+         "gzip or deflate encoded.\n"
+         "# TYPE ddshop_compressed_responses_total counter\n")
+      .append(compressed)
+      .append(
+          "# HELP ddshop_response_bytes_total Response body bytes as "
+          "received and once decoded.\n"
+          "# TYPE ddshop_response_bytes_total counter\n")
+      .append(bytes)
+      .append(
+          "# HELP ddshop_response_decode_seconds_total Time spent "
+          "decompressing response bodies.\n"
+          "# TYPE ddshop_response_decode_seconds_total counter\n")
+      .append(decode);
+  auto &reg = collectors();
+  std::lock_guard<std::mutex> lck(reg.mutex);
+  for (auto &it : reg.collectors) {
+    it.second(out);
+  }
+  return out;
+}
+
+}  // namespace ddshop
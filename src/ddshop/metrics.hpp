@@ -0,0 +1,103 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <string>
+
+#include "histogram.hpp"
+#include "request_phases.hpp"
+
+namespace ddshop {
+
+enum class Endpoint : uint8_t {
+  USER_DETAIL = 0,
+  USER_ADDRESS,
+  CART_CHECK_ALL,
+  CART_INDEX,
+  RESERVE_TIME,
+  CHECK_ORDER,
+  ADD_NEW_ORDER,
+  NOT_PAY_LIST,
+  COUNT
+};
+
+const char *endpointName(Endpoint endpoint);
+
+enum class Outcome : uint8_t {
+  OK = 0,
+  TRANSPORT_ERROR,
+  JSON_ERROR,
+  CODE_5001,
+  CODE_5003,
+  CODE_5004,
+  CODE_OTHER,
+  COUNT
+};
+
+const char *outcomeName(Outcome outcome);
+
+// Maps a business code of a response with success == false.
+Outcome outcomeOfCode(int64_t code);
+
+// Lock-free: only touches the calling thread's shard. Phases are optional.
+void recordRequest(Endpoint endpoint, Outcome outcome, uint64_t ns,
+                   const RequestPhases *phases = nullptr);
+
+// Requests slower than this are logged with their phase breakdown.
+void setSlowRequestThreshold(std::chrono::milliseconds threshold);
+
+// Latency of an endpoint over all outcomes and workers.
+HistogramData requestLatency(Endpoint endpoint);
+
+struct BodyStats {
+  uint64_t responses = 0;
+  uint64_t compressed = 0;
+  uint64_t wire_bytes = 0;
+  uint64_t body_bytes = 0;
+  uint64_t decode_ns = 0;
+};
+
+// Response body sizes of an endpoint over all workers.
+BodyStats responseBodies(Endpoint endpoint);
+
+// Appends Prometheus text exposition lines when /metrics is scraped.
+using MetricsCollector = std::function<void(std::string &)>;
+
+size_t addMetricsCollector(MetricsCollector collector);
+
+void removeMetricsCollector(size_t id);
+
+std::string renderMetrics();
+
+// Times a session call and records it on destruction. The outcome starts
+// as a transport error and is set once the response has been read; the
+// transport fills in the phases of the request.
+class RequestTimer {
+ public:
+  explicit RequestTimer(Endpoint endpoint) : endpoint_(endpoint) {
+    phases_.start = std::chrono::steady_clock::now();
+  }
+  RequestTimer(const RequestTimer &) = delete;
+  void operator=(const RequestTimer &) = delete;
+  ~RequestTimer() { recordRequest(endpoint_, outcome_, elapsed(), &phases_); }
+
+  void setOutcome(Outcome outcome) { outcome_ = outcome; }
+
+  void setCode(int64_t code) { outcome_ = outcomeOfCode(code); }
+
+  RequestPhases &phases() { return phases_; }
+
+  Endpoint endpoint() const { return endpoint_; }
+
+  uint64_t elapsed() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - phases_.start)
+        .count();
+  }
+
+ private:
+  const Endpoint endpoint_;
+  RequestPhases phases_;
+  Outcome outcome_ = Outcome::TRANSPORT_ERROR;
+};
+
+}  // namespace ddshop
@@ -0,0 +1,76 @@
+#include "metrics_server_impl.hpp"
+
+#include "metrics.hpp"
+#include "spdlog/spdlog.h"
+#include "trace.hpp"
+
+namespace ddshop {
+
+namespace {
+
+const auto START_TIMEOUT = std::chrono::seconds(5);
+
+}  // namespace
+
+MetricsServerImpl::MetricsServerImpl() {
+  server_.new_task_queue = []() { return new httplib::ThreadPool(1); };
+  server_.Get("/metrics", [](const httplib::Request &, httplib::Response &res) {
+    res.set_content(renderMetrics(), "text/plain; version=0.0.4");
+  });
+  server_.Get("/trace", [](const httplib::Request &, httplib::Response &res) {
+    res.set_content(renderChromeTrace(), "application/json");
+  });
+}
+
+MetricsServerImpl::~MetricsServerImpl() {
+  server_.stop();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+bool MetricsServerImpl::bind(const std::string &host, int port) {
+  if (port == 0) {
+    port_ = server_.bind_to_any_port(host.c_str());
+  } else if (server_.bind_to_port(host.c_str(), port)) {
+    port_ = port;
+  }
+  if (port_ < 0) {
+    spdlog::error("Failed to bind metrics server to {}:{}", host, port);
+    return false;
+  }
+  thread_ = std::thread([this]() {
+    server_.listen_after_bind();
+    listen_returned_ = true;
+  });
+  // The bundled httplib has no wait_until_ready(). listen_after_bind may
+  // return without ever running, and the socket is already listening, so
+  // a slow start only delays the first scrape and is not worth blocking on.
+  auto deadline = std::chrono::steady_clock::now() + START_TIMEOUT;
+  while (!server_.is_running()) {
+    if (listen_returned_) {
+      spdlog::error("Metrics server on {}:{} failed to start", host, port_);
+      thread_.join();
+      port_ = -1;
+      return false;
+    }
+    if (std::chrono::steady_clock::now() > deadline) {
+      spdlog::warn("Metrics server on {}:{} is slow to start", host, port_);
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  spdlog::info("Serving metrics on http://{}:{}/metrics", host, port_);
+  return true;
+}
+
+std::shared_ptr<MetricsServer> MetricsServer::makeMetricsServer(
+    const std::string &host, int port) {
+  auto server = std::make_shared<MetricsServerImpl>();
+  if (!server->bind(host, port)) {
+    return nullptr;
+  }
+  return server;
+}
+
+}  // namespace ddshop
@@ -0,0 +1,27 @@
+#pragma once
+#include <atomic>
+#include <thread>
+
+#include "ddshop/metrics_server.hpp"
+#include "httplib.h"
+
+namespace ddshop {
+
+class MetricsServerImpl : public MetricsServer {
+ public:
+  MetricsServerImpl();
+
+  ~MetricsServerImpl() override;
+
+  bool bind(const std::string &host, int port);
+
+  int port() const override { return port_; }
+
+ private:
+  httplib::Server server_;
+  std::thread thread_;
+  std::atomic<bool> listen_returned_{false};
+  int port_ = -1;
+};
+
+}  // namespace ddshop
@@ -1,95 +1,123 @@
+#include "sax_extract.hpp"
 #include "session_impl.hpp"
 #include "spdlog/spdlog.h"
 #include "uuid.h"
 
 namespace ddshop {
 
-bool SessionImpl::checkOrder(const std::pair<uint64_t, uint64_t> &reserve_time,
-                             Order &order, int &code) {
-  nlohmann::json package;
+namespace {
 
-  {
-    std::lock_guard<std::mutex> lck(cart_mutex_);
-    if (!cart_data_.is_object() || !cart_data_.contains("products")) {
-      code = -1;
-      return false;
-    }
-    package.emplace_back(cart_data_);
-    order.cart_data = cart_data_;
+// Encoded JSON fragments spliced around the per-attempt reserved time.
+const std::string RESERVED_TIME_END =
+    httplib::detail::encode_query_param(R"(,"reserved_time_end":)");
+const std::string PACKAGES_TAIL = httplib::detail::encode_query_param("}}]");
+const std::string PACKAGE_ORDER_TAIL = httplib::detail::encode_query_param(
+    R"(,"eta_trace_id":"","soon_arrival":"","first_selected_big_time":0,)"
+    R"("receipt_without_sku":0}],"payment_order":)");
+
+const char CHECK_ORDER_FIELDS[] =
+    "&user_ticket_id=default&freight_ticket_id=default&is_use_point=0"
+    "&is_use_balance=0&is_buy_vip=0&coupons_id=&is_buy_coupons=0"
+    "&check_order_type=0&is_support_merge_payment=0&showData=true"
+    "&showMsg=false";
+
+// Closes package_order and adds the remaining addNewOrder fields.
+const std::string DO_ORDER_FIELDS =
+    httplib::detail::encode_query_param("}") +
+    "&showData=true&showMsg=false&ab_config=" +
+    httplib::detail::encode_query_param(R"({"key_onion":"C"})");
+
+}  // namespace
+
+std::string &SessionImpl::checkOrderBody(
+    const Cart &cart, const std::pair<uint64_t, uint64_t> &reserve_time) {
+  auto &body = formBuffer(base_query_);
+  body.append("&packages=").append(cart.packages_head);
+  appendNumber(body, reserve_time.first).append(RESERVED_TIME_END);
+  appendNumber(body, reserve_time.second).append(PACKAGES_TAIL);
+  body.append(CHECK_ORDER_FIELDS);
+  return body;
+}
+
+std::string &SessionImpl::doOrderBody(const Order &order) {
+  auto &body = formBuffer(base_query_);
+  body.append("&package_order=")
+      .append(order.snapshot->cart->package_order_head);
+  appendNumber(body, order.reserve_time.first).append(RESERVED_TIME_END);
+  appendNumber(body, order.reserve_time.second).append(PACKAGE_ORDER_TAIL);
+  body.append(
+      httplib::detail::encode_query_param(order.check_order_data.dump()));
+  body.append(DO_ORDER_FIELDS);
+  return body;
+}
+
+void SessionImpl::checkOrderData(
+    nlohmann::json &data, const Cart &cart,
+    const std::pair<uint64_t, uint64_t> &reserve_time, nlohmann::json &out) {
+  auto &order = data["order"];
+  out = nlohmann::json::object();
+  out["price"] = order["total_money"];
+  out["freight_discount_money"] = order["freight_discount_money"];
+  out["freight_money"] = order["freight_money"];
+  out["order_freight"] = order["freights"][0]["freight"]["freight_real_money"];
+  out["user_ticket_id"] = order["default_coupon"]["_id"];
+  out["reserved_time_start"] = reserve_time.first;
+  out["reserved_time_end"] = reserve_time.second;
+  out["parent_order_sign"] = cart.parent_order_sign;
+  out["address_id"] = base_params_.find("address_id")->second;
+  out["pay_type"] = static_cast<uint8_t>(config_.pay_type);
+  out["product_type"] = 1;
+  out["form_id"];
+  out["receipt_without_sku"];
+  out["vip_money"] = "";
+  out["vip_buy_user_ticket_id"] = "";
+  out["coupons_money"] = "";
+  out["coupons_id"] = "";
+
+  auto uuid_str = uuid::v4::UUID::New().String();
+  uuid_str.erase(std::remove(uuid_str.begin(), uuid_str.end(), '-'),
+                 uuid_str.end());
+  out["form_id"] = uuid_str;
+}
+
+bool SessionImpl::checkOrder(
+    const std::shared_ptr<const CartSnapshot> &snapshot,
+    const std::pair<uint64_t, uint64_t> &reserve_time, Order &order,
+    int &code) {
+  if (!snapshot || !snapshot->cart) {
+    code = -1;
+    return false;
   }
-  package.back()["reserved_time"]["reserved_time_start"] = reserve_time.first;
-  package.back()["reserved_time"]["reserved_time_end"] = reserve_time.second;
+  const auto &cart = *snapshot->cart;
+  order.snapshot = snapshot;
   order.reserve_time = reserve_time;
 
-  auto params = base_params_;
-  params.emplace("packages", package.dump());
-  params.emplace("user_ticket_id", "default");
-  params.emplace("freight_ticket_id", "default");
-  params.emplace("is_use_point", "0");
-  params.emplace("is_use_balance", "0");
-  params.emplace("is_buy_vip", "0");
-  params.emplace("coupons_id", "");
-  params.emplace("is_buy_coupons", "0");
-  params.emplace("check_order_type", "0");
-  params.emplace("is_support_merge_payment", "0");
-  params.emplace("showData", "true");
-  params.emplace("showMsg", "false");
-
+  auto &body = checkOrderBody(cart, reserve_time);
   spdlog::info("Checking order");
-  auto resp = client_.Post("/order/checkOrder", base_headers_, params);
+  RequestTimer timer(Endpoint::CHECK_ORDER);
+  auto resp =
+      post(api_pool_, RequestClass::CHECK, "/order/checkOrder", body, timer);
   if (resp.error() == httplib::Error::Success) {
     nlohmann::json ret_json;
     if (!ensureBasicResp(resp->body, ret_json)) {
       spdlog::error("Failed to parse check order data");
+      timer.setOutcome(Outcome::JSON_ERROR);
       code = -1;
       return false;
     }
     code = ret_json["code"];
+    timer.setCode(ret_json["success"] ? 0 : code);
     if (!ret_json["success"]) {
       if (code == 5001 || code == 5003) {
-        std::lock_guard<std::mutex> lck(cart_mutex_);
-        cart_data_.clear();
-        reserve_time_.clear();
+        clearCart();
       } else if (code == 5004) {
-        reserve_time_.clear();
+        clearReserveTime();
       }
       spdlog::warn("Check order return failed");
       return false;
     }
-    nlohmann::json out;
-    out["price"] = ret_json["data"]["order"]["total_money"];
-    out["freight_discount_money"] =
-        ret_json["data"]["order"]["freight_discount_money"];
-    out["freight_money"] = ret_json["data"]["order"]["freight_money"];
-    out["order_freight"] = ret_json["data"]["order"]["freights"][0]["freight"]
-                                   ["freight_real_money"];
-    out["user_ticket_id"] = ret_json["data"]["order"]["default_coupon"]["_id"];
-    out["reserved_time_start"] = reserve_time.first;
-    out["reserved_time_end"] = reserve_time.second;
-    out["parent_order_sign"] = order.cart_data["parent_order_sign"];
-    out["address_id"] = base_params_.find("address_id")->second;
-    out["pay_type"] = static_cast<uint8_t>(config_.pay_type);
-    out["product_type"] = 1;
-    out["form_id"];
-    out["receipt_without_sku"];
-    out["vip_money"] = "";
-    out["vip_buy_user_ticket_id"] = "";
-    out["coupons_money"] = "";
-    out["coupons_id"] = "";
-
-    auto uuid_str = uuid::v4::UUID::New().String();
-    uuid_str.erase(std::remove(uuid_str.begin(), uuid_str.end(), '-'),
-                   uuid_str.end());
-    out["form_id"] = uuid_str;
-
-    order.check_order_data = out;
-
-    order.cart_data["reserved_time_start"] = reserve_time.first;
-    order.cart_data["reserved_time_end"] = reserve_time.second;
-    order.cart_data["eta_trace_id"] = "";
-    order.cart_data["soon_arrival"] = "";
-    order.cart_data["first_selected_big_time"] = 0;
-    order.cart_data["receipt_without_sku"] = 0;
+    checkOrderData(ret_json["data"], cart, reserve_time,
+                   order.check_order_data);
 
     return true;
   } else {
@@ -100,49 +128,39 @@ bool SessionImpl::checkOrder(const std::pair<uint64_t, uint64_t> &reserve_time,
 }
 
 bool SessionImpl::doOrder(Order &order, int &code) {
-  if (!order.check_order_data.is_object() ||
+  if (!order.snapshot || !order.snapshot->cart ||
+      !order.check_order_data.is_object() ||
       !order.check_order_data.contains("price")) {
     code = -1;
     return false;
   }
+  const auto &cart = *order.snapshot->cart;
 
-  nlohmann::json req;
-  req["payment_order"] = order.check_order_data;
-  req["packages"].emplace_back(order.cart_data);
-
-  auto params = base_params_;
-  params.emplace("package_order", req.dump());
-  params.emplace("showData", "true");
-  params.emplace("showMsg", "false");
-  params.emplace("ab_config", R"({"key_onion":"C"})");
-
+  auto &body = doOrderBody(order);
   spdlog::info("Submitting order");
-  auto resp = client_.Post("/order/addNewOrder", base_headers_, params);
+  RequestTimer timer(Endpoint::ADD_NEW_ORDER);
+  auto resp = post(api_pool_, RequestClass::SUBMIT, "/order/addNewOrder",
+                   body, timer);
   if (resp.error() == httplib::Error::Success) {
     nlohmann::json ret_json;
     if (!ensureBasicResp(resp->body, ret_json)) {
       spdlog::error("Failed to parse add new order data");
+      timer.setOutcome(Outcome::JSON_ERROR);
       code = -1;
       return false;
     }
-    spdlog::debug("Submit order resp {}", resp->body);
     code = ret_json["code"];
+    timer.setCode(ret_json["success"] ? 0 : code);
     if (ret_json["success"]) {
       spdlog::info("Submit order success");
-      code = order.cart_data["products"].size();
-      {
-        std::lock_guard<std::mutex> lck(cart_mutex_);
-        cart_data_.clear();
-        reserve_time_.clear();
-      }
+      code = cart.products.size();
+      clearCart();
       return true;
     } else {
       if (code == 5001 || code == 5003) {
-        std::lock_guard<std::mutex> lck(cart_mutex_);
-        cart_data_.clear();
-        reserve_time_.clear();
+        clearCart();
       } else if (code == 5004) {
-        reserve_time_.clear();
+        clearReserveTime();
       }
       spdlog::warn("Submit order failed, code {}, msg {}",
                    ret_json["code"].get<int>(), ret_json["msg"]);
@@ -161,18 +179,24 @@ int SessionImpl::hasUnpaidOrder() {
     return 0;
   }
   spdlog::info("Fetching unpaid order list");
-  auto resp = client_.Post("/order/notPayList", base_headers_, base_params_);
+  RequestTimer timer(Endpoint::NOT_PAY_LIST);
+  auto &body = formBuffer(base_query_);
+  auto resp = post(api_pool_, RequestClass::HOUSEKEEPING, "/order/notPayList",
+                   body, timer);
   if (resp.error() == httplib::Error::Success) {
-    nlohmann::json ret_json;
-    if (!ensureBasicResp(resp->body, ret_json)) {
+    BasicResp ret;
+    size_t count = 0;
+    if (!countOrderList(resp->body, ret, count)) {
       spdlog::error("Failed parsing no pay list data");
+      timer.setOutcome(Outcome::JSON_ERROR);
       return 0;
     }
-    if (!ret_json["success"]) {
+    timer.setCode(ret.success ? 0 : ret.code);
+    if (!ret.success) {
       spdlog::error("Fetch no pay list data return failed");
       return 0;
     }
-    return static_cast<int>(ret_json["data"]["order_list"].size());
+    return static_cast<int>(count);
   } else {
     spdlog::error("Failed fetching no pay list data");
     return 0;
@@ -0,0 +1,80 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace ddshop {
+
+enum class Phase : uint8_t { QUEUE = 0, DNS, CONNECT, TLS, TTFB, BODY, COUNT };
+
+const char *phaseName(Phase phase);
+
+// Timestamps of one request. Unset points are phases the request skipped,
+// e.g. DNS, connect and TLS on a reused keep-alive connection. Plain HTTP
+// has no hook after connect, so there CONNECT is folded into TTFB.
+struct RequestPhases {
+  using TimePoint = std::chrono::steady_clock::time_point;
+
+  static const size_t COUNT = static_cast<size_t>(Phase::COUNT);
+
+  TimePoint start;
+  TimePoint acquired;
+  TimePoint dns_done;
+  TimePoint connected;
+  TimePoint tls_done;
+  TimePoint first_byte;
+  TimePoint end;
+
+  // Response body as received and once decoded, and the time spent
+  // decoding it. The sizes match when the body was not compressed.
+  bool compressed = false;
+  uint64_t wire_bytes = 0;
+  uint64_t body_bytes = 0;
+  uint64_t decode_ns = 0;
+
+  // Nanoseconds per phase; false for the phases that did not happen.
+  void durations(uint64_t (&ns)[COUNT], bool (&happened)[COUNT]) const {
+    auto span = [](TimePoint from, TimePoint to) -> uint64_t {
+      return to > from ? std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             to - from)
+                             .count()
+                       : 0;
+    };
+    for (size_t i = 0; i < COUNT; ++i) {
+      ns[i] = 0;
+      happened[i] = false;
+    }
+    auto mark = [&](Phase phase, TimePoint from, TimePoint to) {
+      ns[static_cast<size_t>(phase)] = span(from, to);
+      happened[static_cast<size_t>(phase)] = true;
+    };
+    auto last = start;
+    if (acquired != TimePoint()) {
+      mark(Phase::QUEUE, last, acquired);
+      last = acquired;
+    }
+    if (dns_done != TimePoint()) {
+      mark(Phase::DNS, last, dns_done);
+      last = dns_done;
+    }
+    if (connected != TimePoint()) {
+      mark(Phase::CONNECT, last, connected);
+      last = connected;
+    }
+    if (tls_done != TimePoint()) {
+      mark(Phase::TLS, last, tls_done);
+      last = tls_done;
+    }
+    if (first_byte != TimePoint()) {
+      mark(Phase::TTFB, last, first_byte);
+      mark(Phase::BODY, first_byte, end);
+    } else if (end != TimePoint()) {
+      mark(Phase::TTFB, last, end);
+    }
+  }
+
+  // e.g. "queue 0.0ms dns 3.1ms connect 20.4ms tls 41.0ms ttfb 812.9ms ..."
+  std::string describe() const;
+};
+
+}  // namespace ddshop
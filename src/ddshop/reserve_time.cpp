@@ -1,75 +1,64 @@
+#include "sax_extract.hpp"
 #include "session_impl.hpp"
 #include "spdlog/spdlog.h"
 
 namespace ddshop {
 
 bool SessionImpl::refreshReserveTime() {
-  nlohmann::json products;
-  {
-    std::lock_guard<std::mutex> lck(cart_mutex_);
-    if (!cart_data_.is_object() || !cart_data_.contains("products")) {
-      return false;
-    }
-    products.emplace_back(cart_data_["products"]);
+  auto snapshot = cart_.load();
+  if (!snapshot->cart) {
+    return false;
   }
-  auto params = base_params_;
+  auto &body = formBuffer(base_query_);
+  body.append("&products=").append(snapshot->cart->products_form);
+  body.append("&group_config_id=&isBridge=false");
 
-  params.emplace("products", products.dump());
-  params.emplace("group_config_id", "");
-  params.emplace("isBridge", "false");
-
-  auto resp = client_.Post("/order/getMultiReserveTime", base_headers_, params);
+  RequestTimer timer(Endpoint::RESERVE_TIME);
+  auto resp = post(api_pool_, RequestClass::RESERVE_TIME,
+                   "/order/getMultiReserveTime", body, timer);
   if (resp.error() == httplib::Error::Success) {
-    nlohmann::json ret_json;
-    if (!ensureBasicResp(resp->body, ret_json)) {
+    // Reused across polls so steady state extraction does not allocate.
+    static thread_local std::vector<std::pair<uint64_t, uint64_t>> out;
+    BasicResp ret;
+    bool has_time = false;
+    if (!extractReserveTimes(resp->body, ret, has_time, out)) {
       spdlog::error("Failed parse getReserveTime data");
-      spdlog::debug(resp->body);
+      timer.setOutcome(Outcome::JSON_ERROR);
       return false;
     }
-    if (!ret_json["success"]) {
-      spdlog::warn("Refresh reserve time failed, code {}, msg {}",
-                   ret_json["code"].get<int64_t>(), ret_json["msg"]);
+    timer.setCode(ret.success ? 0 : ret.code);
+    if (!ret.success) {
+      spdlog::warn("Refresh reserve time failed, code {}, msg {}", ret.code,
+                   ret.msg);
       return false;
     }
-    if (ret_json["data"].empty() || ret_json["data"][0]["time"].empty()) {
+    if (!has_time) {
       spdlog::warn("No available reserve time");
-      {
-        std::lock_guard<std::mutex> lck(cart_mutex_);
-        reserve_time_.clear();
-      }
+      clearReserveTime();
       return false;
     }
-    std::vector<std::pair<uint64_t, uint64_t>> out;
-    for (auto &it : ret_json["data"][0]["time"][0]["times"]) {
-      if (it["disableType"] != 0) {
-        continue;
-      }
-      spdlog::debug("Found reserve time {} to {} {}",
-                    it["start_timestamp"].get<uint64_t>(),
-                    it["end_timestamp"].get<uint64_t>(), it["select_msg"]);
-      out.emplace_back(std::make_pair(it["start_timestamp"].get<uint64_t>(),
-                                      it["end_timestamp"].get<uint64_t>()));
+    for (auto &it : out) {
+      SPDLOG_DEBUG("Found reserve time {} to {}", it.first, it.second);
     }
     spdlog::info("Found {} available reserve time", out.size());
-    {
-      std::lock_guard<std::mutex> lck(cart_mutex_);
-      if (!cart_data_.is_object() || !cart_data_.contains("products")) {
-        return false;
-      }
-      reserve_time_.swap(out);
-    }
-    return true;
+    // Only publish against the cart the times were requested for.
+    bool published = false;
+    cart_.update([&snapshot, &published](const CartSnapshot &current,
+                                         CartSnapshot &next) {
+      published = current.cart == snapshot->cart;
+      next.cart = current.cart;
+      next.reserve_time = out;
+      return published;
+    });
+    return published;
   } else {
     spdlog::warn("Failed get reserve time");
     return false;
   }
 }
 
-void SessionImpl::getReserveTime(
-    std::vector<std::pair<uint64_t, uint64_t>> &out) {
-  out.clear();
-  std::lock_guard<std::mutex> lck(cart_mutex_);
-  out.assign(reserve_time_.begin(), reserve_time_.end());
+std::shared_ptr<const CartSnapshot> SessionImpl::getSnapshot() {
+  return cart_.load();
 }
 
 }  // namespace ddshop
@@ -0,0 +1,383 @@
+#include "resolver.hpp"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+
+#include "metrics.hpp"
+#include "spdlog/spdlog.h"
+
+namespace ddshop {
+
+namespace {
+
+bool isIpLiteral(const std::string &host) {
+  unsigned char buf[sizeof(struct in6_addr)];
+  return inet_pton(AF_INET, host.c_str(), buf) == 1 ||
+         inet_pton(AF_INET6, host.c_str(), buf) == 1;
+}
+
+std::string joinAddresses(const std::vector<std::string> &ips) {
+  std::string out;
+  for (auto &it : ips) {
+    if (!out.empty()) {
+      out.append(", ");
+    }
+    out.append(it);
+  }
+  return out;
+}
+
+}  // namespace
+
+Resolver::Resolver(std::string hosts_file)
+    : hosts_file_(std::move(hosts_file)), running_(true) {
+  metrics_collector_ = addMetricsCollector([this](std::string &out) {
+    std::string rtt;
+    std::string up;
+    std::string failures;
+    {
+      std::lock_guard<std::mutex> lck(mutex_);
+      auto now = std::chrono::steady_clock::now();
+      for (auto &entry : entries_) {
+        failures.append("ddshop_dns_resolve_failures_total{host=\"")
+            .append(entry.host)
+            .append("\"} ")
+            .append(std::to_string(entry.resolve_failures))
+            .append("\n");
+        for (auto &address : entry.addresses) {
+          auto labels = "{host=\"" + entry.host + "\",ip=\"" + address.ip +
+                        "\"} ";
+          if (address.rtt_ms >= 0) {
+            rtt.append("ddshop_dns_address_rtt_seconds")
+                .append(labels)
+                .append(std::to_string(address.rtt_ms / 1e3))
+                .append("\n");
+          }
+          up.append("ddshop_dns_address_up")
+              .append(labels)
+              .append(address.down_until > now ? "0" : "1")
+              .append("\n");
+        }
+      }
+    }
+    out.append(
+           "# HELP ddshop_dns_address_rtt_seconds Smoothed TCP connect time "
+           "to each resolved address.\n"
+           "# TYPE ddshop_dns_address_rtt_seconds gauge\n")
+        .append(rtt)
+        .append(
+            "# HELP ddshop_dns_address_up 0 while an address is avoided "
+            "after a failed connection.\n"
+            "# TYPE ddshop_dns_address_up gauge\n")
+        .append(up)
+        .append(
+            "# HELP ddshop_dns_resolve_failures_total Background lookups "
+            "that failed, the previous addresses stay in use.\n"
+            "# TYPE ddshop_dns_resolve_failures_total counter\n")
+        .append(failures);
+  });
+  thread_ = std::thread([this]() { run(); });
+}
+
+Resolver::~Resolver() {
+  running_ = false;
+  wake_.interrupt();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  removeMetricsCollector(metrics_collector_);
+}
+
+void Resolver::watch(const std::string &host, int port) {
+  if (host.empty() || isIpLiteral(host)) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lck(mutex_);
+    if (find(host)) {
+      return;
+    }
+  }
+  // The first lookup runs here so the first connections already find the
+  // addresses, the background thread probes them right after.
+  std::vector<std::string> ips;
+  if (resolve(host, ips)) {
+    spdlog::info("Resolved {} to {}", host, joinAddresses(ips));
+  } else {
+    spdlog::warn("Resolving {} failed, retrying in the background", host);
+  }
+  {
+    std::lock_guard<std::mutex> lck(mutex_);
+    if (find(host)) {
+      return;
+    }
+    Entry entry;
+    entry.host = host;
+    entry.port = port;
+    for (auto &ip : ips) {
+      Address address;
+      address.ip = ip;
+      entry.addresses.emplace_back(std::move(address));
+    }
+    entries_.emplace_back(std::move(entry));
+  }
+  wake_.notify();
+}
+
+bool Resolver::pick(const std::string &host, std::string &ip) {
+  std::lock_guard<std::mutex> lck(mutex_);
+  auto entry = find(host);
+  if (!entry || entry->addresses.empty()) {
+    return false;
+  }
+  auto now = std::chrono::steady_clock::now();
+  // Up before down, then measured before unmeasured, then fastest. If all
+  // are down, the one that comes back first.
+  auto better = [now](const Address &a, const Address &b) {
+    auto a_up = a.down_until <= now;
+    auto b_up = b.down_until <= now;
+    if (a_up != b_up) {
+      return a_up;
+    }
+    if (!a_up) {
+      return a.down_until < b.down_until;
+    }
+    if ((a.rtt_ms >= 0) != (b.rtt_ms >= 0)) {
+      return a.rtt_ms >= 0;
+    }
+    return a.rtt_ms < b.rtt_ms;
+  };
+  ip = std::min_element(entry->addresses.begin(), entry->addresses.end(),
+                        better)
+           ->ip;
+  return true;
+}
+
+void Resolver::report(const std::string &host, const std::string &ip,
+                      bool ok, std::chrono::nanoseconds connect_time) {
+  std::lock_guard<std::mutex> lck(mutex_);
+  auto entry = find(host);
+  if (!entry) {
+    return;
+  }
+  for (auto &address : entry->addresses) {
+    if (address.ip != ip) {
+      continue;
+    }
+    if (ok) {
+      address.down_until = TimePoint();
+      if (connect_time.count() > 0) {
+        updateRtt(address, connect_time.count() / 1e6);
+      }
+    } else {
+      address.down_until = std::chrono::steady_clock::now() + FAILURE_BACKOFF;
+      spdlog::warn("Connection to {} at {} failed, avoiding it for {}s", host,
+                   ip, FAILURE_BACKOFF.count());
+    }
+    return;
+  }
+}
+
+void Resolver::run() {
+  auto seen = wake_.sequence();
+  while (running_) {
+    auto now = std::chrono::steady_clock::now();
+    auto next = now + REFRESH_INTERVAL;
+    std::vector<std::pair<std::string, int>> due;
+    {
+      std::lock_guard<std::mutex> lck(mutex_);
+      for (auto &entry : entries_) {
+        if (entry.refresh_at <= now) {
+          due.emplace_back(entry.host, entry.port);
+        } else {
+          next = std::min(next, entry.refresh_at);
+        }
+      }
+    }
+    // Lookups and probes run without the lock, pick() never waits on them.
+    for (auto &it : due) {
+      if (!running_) {
+        return;
+      }
+      refresh(it.first, it.second);
+    }
+    if (!due.empty()) {
+      continue;
+    }
+    wake_.waitUntil(next, seen);
+  }
+}
+
+void Resolver::refresh(const std::string &host, int port) {
+  std::vector<std::string> ips;
+  auto ok = resolve(host, ips);
+  std::vector<double> rtts;
+  for (auto &ip : ips) {
+    rtts.push_back(probe(ip, port));
+  }
+
+  std::lock_guard<std::mutex> lck(mutex_);
+  auto entry = find(host);
+  auto now = std::chrono::steady_clock::now();
+  if (!ok) {
+    ++entry->resolve_failures;
+    entry->refresh_at = now + RETRY_INTERVAL;
+    spdlog::warn("Resolving {} failed, keeping {} known addresses", host,
+                 entry->addresses.size());
+    return;
+  }
+  std::vector<Address> addresses;
+  for (size_t i = 0; i < ips.size(); ++i) {
+    Address address;
+    address.ip = ips[i];
+    for (auto &it : entry->addresses) {
+      if (it.ip == address.ip) {
+        address = it;
+        break;
+      }
+    }
+    if (rtts[i] >= 0) {
+      updateRtt(address, rtts[i]);
+    } else {
+      address.down_until = now + FAILURE_BACKOFF;
+    }
+    addresses.emplace_back(std::move(address));
+  }
+  auto changed = addresses.size() != entry->addresses.size() ||
+                 !std::equal(addresses.begin(), addresses.end(),
+                             entry->addresses.begin(),
+                             [](const Address &a, const Address &b) {
+                               return a.ip == b.ip;
+                             });
+  entry->addresses = std::move(addresses);
+  entry->refresh_at = now + REFRESH_INTERVAL;
+  if (changed) {
+    std::string described;
+    for (auto &it : entry->addresses) {
+      if (!described.empty()) {
+        described.append(", ");
+      }
+      described.append(it.ip);
+      described.append(it.rtt_ms >= 0 ? fmt::format(" {:.1f}ms", it.rtt_ms)
+                                      : std::string(" unreachable"));
+    }
+    spdlog::info("Resolved {} to {}", host, described);
+  }
+}
+
+bool Resolver::resolve(const std::string &host,
+                       std::vector<std::string> &ips) {
+  if (lookupHostsFile(host, ips)) {
+    return true;
+  }
+  struct addrinfo hints {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo *result;
+  auto err = getaddrinfo(host.c_str(), nullptr, &hints, &result);
+  if (err) {
+    spdlog::debug("getaddrinfo {}: {}", host, gai_strerror(err));
+    return false;
+  }
+  for (auto rp = result; rp; rp = rp->ai_next) {
+    char buf[NI_MAXHOST];
+    if (getnameinfo(rp->ai_addr, rp->ai_addrlen, buf, sizeof(buf), nullptr, 0,
+                    NI_NUMERICHOST) == 0 &&
+        std::find(ips.begin(), ips.end(), buf) == ips.end()) {
+      ips.emplace_back(buf);
+    }
+  }
+  freeaddrinfo(result);
+  return !ips.empty();
+}
+
+bool Resolver::lookupHostsFile(const std::string &host,
+                               std::vector<std::string> &ips) {
+  if (hosts_file_.empty()) {
+    return false;
+  }
+  // Read on every refresh so edits apply without a restart.
+  std::ifstream fin(hosts_file_);
+  std::string line;
+  while (std::getline(fin, line)) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream fields(line);
+    std::string ip;
+    std::string name;
+    fields >> ip;
+    while (fields >> name) {
+      if (name == host && isIpLiteral(ip) &&
+          std::find(ips.begin(), ips.end(), ip) == ips.end()) {
+        ips.emplace_back(ip);
+      }
+    }
+  }
+  if (!ips.empty()) {
+    spdlog::debug("{} resolved from {} to {}", host, hosts_file_,
+                  joinAddresses(ips));
+  }
+  return !ips.empty();
+}
+
+double Resolver::probe(const std::string &ip, int port) {
+  struct addrinfo hints {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+  struct addrinfo *result;
+  if (getaddrinfo(ip.c_str(), std::to_string(port).c_str(), &hints,
+                  &result)) {
+    return -1;
+  }
+  double rtt_ms = -1;
+  auto sock = socket(result->ai_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (sock >= 0) {
+    auto start = std::chrono::steady_clock::now();
+    auto ret = connect(sock, result->ai_addr, result->ai_addrlen);
+    if (ret < 0 && errno == EINPROGRESS) {
+      struct pollfd pfd {};
+      pfd.fd = sock;
+      pfd.events = POLLOUT;
+      int err = 0;
+      socklen_t len = sizeof(err);
+      if (poll(&pfd, 1, static_cast<int>(PROBE_TIMEOUT.count())) == 1 &&
+          getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len) == 0 &&
+          err == 0) {
+        ret = 0;
+      }
+    }
+    if (ret == 0) {
+      rtt_ms = std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+    }
+    close(sock);
+  }
+  freeaddrinfo(result);
+  return rtt_ms;
+}
+
+void Resolver::updateRtt(Address &address, double rtt_ms) {
+  address.rtt_ms = address.rtt_ms < 0 ? rtt_ms
+                                      : address.rtt_ms * (1 - RTT_WEIGHT) +
+                                            rtt_ms * RTT_WEIGHT;
+}
+
+Resolver::Entry *Resolver::find(const std::string &host) {
+  for (auto &it : entries_) {
+    if (it.host == host) {
+      return &it;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace ddshop
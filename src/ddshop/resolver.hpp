@@ -0,0 +1,82 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "stage_signal.hpp"
+
+namespace ddshop {
+
+// Resolves hosts on a background thread and refreshes them before they go
+// stale, so opening a connection never waits on DNS. Every address keeps a
+// smoothed TCP connect time, and connections go to the fastest address
+// that has not failed recently.
+class Resolver {
+ public:
+  // Names listed in hosts_file, in /etc/hosts format, resolve from it
+  // instead of DNS.
+  explicit Resolver(std::string hosts_file = "");
+  ~Resolver();
+
+  // Resolves host and keeps it fresh in the background, probing its
+  // addresses on port. IP literals and hosts already watched are ignored.
+  void watch(const std::string &host, int port);
+
+  // The address to connect to host with. False while host has not been
+  // resolved yet, the caller resolves it itself then.
+  bool pick(const std::string &host, std::string &ip);
+
+  // Feeds back a connection to ip, with its connect time if it was timed.
+  void report(const std::string &host, const std::string &ip, bool ok,
+              std::chrono::nanoseconds connect_time);
+
+ private:
+  using TimePoint = std::chrono::steady_clock::time_point;
+
+  // Refreshes ahead of the 60s TTL the API hosts are served with.
+  const std::chrono::seconds REFRESH_INTERVAL{30};
+  const std::chrono::seconds RETRY_INTERVAL{2};
+  // An address that failed is avoided for this long.
+  const std::chrono::seconds FAILURE_BACKOFF{30};
+  const std::chrono::milliseconds PROBE_TIMEOUT{1000};
+  // Weight of a new RTT sample in the smoothed value.
+  const double RTT_WEIGHT = 0.3;
+
+  struct Address {
+    std::string ip;
+    // Smoothed connect time, negative until measured.
+    double rtt_ms = -1;
+    TimePoint down_until;
+  };
+
+  struct Entry {
+    std::string host;
+    int port;
+    std::vector<Address> addresses;
+    TimePoint refresh_at;
+    uint64_t resolve_failures = 0;
+  };
+
+  const std::string hosts_file_;
+  size_t metrics_collector_;
+
+  std::mutex mutex_;
+  std::vector<Entry> entries_;
+  StageSignal wake_;
+  std::atomic<bool> running_;
+  std::thread thread_;
+
+  void run();
+  void refresh(const std::string &host, int port);
+  bool resolve(const std::string &host, std::vector<std::string> &ips);
+  bool lookupHostsFile(const std::string &host, std::vector<std::string> &ips);
+  // TCP connect time to ip:port in ms, negative if it failed.
+  double probe(const std::string &ip, int port);
+  void updateRtt(Address &address, double rtt_ms);
+  Entry *find(const std::string &host);
+};
+
+}  // namespace ddshop
@@ -0,0 +1,261 @@
+#include "sax_extract.hpp"
+
+#include "nlohmann/json.hpp"
+
+namespace ddshop {
+
+namespace {
+
+enum class Key : uint8_t {
+  OTHER,
+  SUCCESS,
+  CODE,
+  MSG,
+  DATA,
+  TIME,
+  TIMES,
+  START_TIMESTAMP,
+  END_TIMESTAMP,
+  DISABLE_TYPE,
+  ORDER_LIST
+};
+
+Key classify(const std::string &key) {
+  static const std::pair<const char *, Key> KEYS[] = {
+      {"success", Key::SUCCESS},
+      {"code", Key::CODE},
+      {"msg", Key::MSG},
+      {"data", Key::DATA},
+      {"time", Key::TIME},
+      {"times", Key::TIMES},
+      {"start_timestamp", Key::START_TIMESTAMP},
+      {"end_timestamp", Key::END_TIMESTAMP},
+      {"disableType", Key::DISABLE_TYPE},
+      {"order_list", Key::ORDER_LIST},
+  };
+  for (auto &it : KEYS) {
+    if (key == it.first) {
+      return it.second;
+    }
+  }
+  return Key::OTHER;
+}
+
+// Tracks the path of the value being parsed with a fixed-depth frame stack
+// and hands the values the callers care about to the mode specific hooks.
+class ExtractSax : public nlohmann::json_sax<nlohmann::json> {
+ public:
+  enum class Mode { RESERVE_TIME, ORDER_LIST };
+
+  ExtractSax(Mode mode, BasicResp &resp) : mode_(mode), resp_(resp) {}
+
+  bool has_time = false;
+  std::vector<std::pair<uint64_t, uint64_t>> *slots = nullptr;
+  size_t order_count = 0;
+
+  bool null() override {
+    beginValue();
+    return true;
+  }
+
+  bool boolean(bool val) override {
+    beginValue();
+    if (atRoot(Key::SUCCESS)) {
+      resp_.has_success = true;
+      resp_.success = val;
+    }
+    return true;
+  }
+
+  bool number_integer(number_integer_t val) override {
+    beginValue();
+    number(val);
+    return true;
+  }
+
+  bool number_unsigned(number_unsigned_t val) override {
+    beginValue();
+    number(static_cast<int64_t>(val));
+    return true;
+  }
+
+  bool number_float(number_float_t, const string_t &) override {
+    beginValue();
+    return true;
+  }
+
+  bool string(string_t &val) override {
+    beginValue();
+    if (atRoot(Key::MSG)) {
+      resp_.has_msg = true;
+      resp_.msg.swap(val);
+    }
+    return true;
+  }
+
+  bool binary(binary_t &) override {
+    beginValue();
+    return true;
+  }
+
+  bool start_object(std::size_t) override {
+    beginValue();
+    if (mode_ == Mode::RESERVE_TIME && depth_ == 6 && inTimes()) {
+      slot_start_ = 0;
+      slot_end_ = 0;
+      slot_disable_ = -1;
+    }
+    return push(false);
+  }
+
+  bool key(string_t &val) override {
+    if (depth_ > 0 && !overflow_) {
+      frames_[depth_ - 1].key = classify(val);
+    }
+    return true;
+  }
+
+  bool end_object() override {
+    if (mode_ == Mode::RESERVE_TIME && depth_ == 7 && inTimes() &&
+        slot_disable_ == 0) {
+      slots->emplace_back(slot_start_, slot_end_);
+    }
+    return pop();
+  }
+
+  bool start_array(std::size_t) override {
+    beginValue();
+    return push(true);
+  }
+
+  bool end_array() override { return pop(); }
+
+  bool parse_error(std::size_t, const std::string &,
+                   const nlohmann::detail::exception &) override {
+    return false;
+  }
+
+ private:
+  struct Frame {
+    bool array;
+    Key key;
+    size_t index;
+  };
+  static const size_t MAX_DEPTH = 8;
+
+  const Mode mode_;
+  BasicResp &resp_;
+  Frame frames_[MAX_DEPTH];
+  size_t depth_ = 0;
+  size_t overflow_ = 0;
+
+  uint64_t slot_start_ = 0;
+  uint64_t slot_end_ = 0;
+  int64_t slot_disable_ = -1;
+
+  bool push(bool array) {
+    if (depth_ == MAX_DEPTH) {
+      ++overflow_;
+    } else {
+      frames_[depth_++] = Frame{array, Key::OTHER, 0};
+    }
+    return true;
+  }
+
+  bool pop() {
+    if (overflow_) {
+      --overflow_;
+    } else if (depth_) {
+      --depth_;
+    }
+    return true;
+  }
+
+  bool isObject(size_t i, Key key) const {
+    return !frames_[i].array && frames_[i].key == key;
+  }
+
+  // Inside the first element of the array at frame i.
+  bool isFirst(size_t i) const {
+    return frames_[i].array && frames_[i].index == 1;
+  }
+
+  bool atRoot(Key key) const { return depth_ == 1 && isObject(0, key); }
+
+  // Inside data[0].time[0].times
+  bool inTimes() const {
+    return !overflow_ && isObject(0, Key::DATA) && isFirst(1) &&
+           isObject(2, Key::TIME) && isFirst(3) && isObject(4, Key::TIMES) &&
+           frames_[5].array;
+  }
+
+  // Called first for every value, whatever its type.
+  void beginValue() {
+    if (overflow_ || depth_ == 0) {
+      return;
+    }
+    auto &parent = frames_[depth_ - 1];
+    if (parent.array) {
+      ++parent.index;
+    }
+    if (depth_ == 1 && isObject(0, Key::DATA)) {
+      resp_.has_data = true;
+    }
+    if (mode_ == Mode::RESERVE_TIME) {
+      if (depth_ == 4 && isObject(0, Key::DATA) && isFirst(1) &&
+          isObject(2, Key::TIME) && frames_[3].array) {
+        has_time = true;
+      }
+    } else if (depth_ == 3 && isObject(0, Key::DATA) &&
+               isObject(1, Key::ORDER_LIST) && frames_[2].array) {
+      ++order_count;
+    }
+  }
+
+  void number(int64_t val) {
+    if (atRoot(Key::CODE)) {
+      resp_.has_code = true;
+      resp_.code = val;
+    } else if (mode_ == Mode::RESERVE_TIME && depth_ == 7 && inTimes()) {
+      switch (frames_[6].key) {
+        case Key::START_TIMESTAMP:
+          slot_start_ = val;
+          break;
+        case Key::END_TIMESTAMP:
+          slot_end_ = val;
+          break;
+        case Key::DISABLE_TYPE:
+          slot_disable_ = val;
+          break;
+        default:
+          break;
+      }
+    }
+  }
+};
+
+}  // namespace
+
+bool extractReserveTimes(const std::string &body, BasicResp &resp,
+                         bool &has_time,
+                         std::vector<std::pair<uint64_t, uint64_t>> &out) {
+  out.clear();
+  ExtractSax sax(ExtractSax::Mode::RESERVE_TIME, resp);
+  sax.slots = &out;
+  if (!nlohmann::json::sax_parse(body, &sax) || !resp.valid()) {
+    return false;
+  }
+  has_time = sax.has_time;
+  return true;
+}
+
+bool countOrderList(const std::string &body, BasicResp &resp, size_t &count) {
+  ExtractSax sax(ExtractSax::Mode::ORDER_LIST, resp);
+  if (!nlohmann::json::sax_parse(body, &sax) || !resp.valid()) {
+    return false;
+  }
+  count = sax.order_count;
+  return true;
+}
+
+}  // namespace ddshop
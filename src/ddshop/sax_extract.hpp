@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ddshop {
+
+// The envelope fields ensureBasicResp checks, extracted while streaming.
+struct BasicResp {
+  bool has_success = false;
+  bool success = false;
+  bool has_code = false;
+  int64_t code = 0;
+  bool has_msg = false;
+  std::string msg;
+  bool has_data = false;
+
+  bool valid() const {
+    return has_success && (success ? has_data : has_code && has_msg);
+  }
+};
+
+// Streams a getMultiReserveTime response and appends the enabled slots of
+// data[0].time[0].times to out, without building a DOM. has_time is false
+// when data or data[0].time is empty. Returns false on a parse error or an
+// invalid envelope.
+bool extractReserveTimes(const std::string &body, BasicResp &resp,
+                         bool &has_time,
+                         std::vector<std::pair<uint64_t, uint64_t>> &out);
+
+// Streams a notPayList response and counts data.order_list.
+bool countOrderList(const std::string &body, BasicResp &resp, size_t &count);
+
+}  // namespace ddshop
@@ -0,0 +1,180 @@
+#include "ddshop/schedule.hpp"
+
+#include <algorithm>
+#include <ctime>
+
+#include "fmt/format.h"
+
+namespace ddshop {
+
+namespace {
+
+// Normalizes day to local noon of its date, filling in the weekday.
+void normalizeDay(struct tm &day) {
+  day.tm_hour = 12;
+  day.tm_min = 0;
+  day.tm_sec = 0;
+  day.tm_isdst = -1;
+  mktime(&day);
+}
+
+// The instant secs after midnight on day, plus days. mktime resolves DST.
+std::chrono::system_clock::time_point at(const struct tm &day, int days,
+                                         uint32_t secs) {
+  struct tm t = day;
+  t.tm_mday += days;
+  t.tm_hour = secs / 3600;
+  t.tm_min = secs / 60 % 60;
+  t.tm_sec = secs % 60;
+  t.tm_isdst = -1;
+  return std::chrono::system_clock::from_time_t(mktime(&t));
+}
+
+void addWindow(const Schedule &schedule, const struct tm &day,
+               std::chrono::system_clock::time_point now,
+               std::vector<ScheduleWindow> &out) {
+  if (!(schedule.weekdays & (1 << day.tm_wday))) {
+    return;
+  }
+  ScheduleWindow window;
+  window.start = at(day, 0, schedule.start);
+  window.stop = at(day, schedule.stop > schedule.start ? 0 : 1, schedule.stop);
+  if (window.stop > now) {
+    out.push_back(window);
+  }
+}
+
+bool parseTime(const nlohmann::json &json, uint32_t &secs) {
+  if (!json.is_array() || json.size() < 2 || json.size() > 3) {
+    return false;
+  }
+  for (auto &it : json) {
+    if (!it.is_number_unsigned()) {
+      return false;
+    }
+  }
+  uint32_t h = json[0];
+  uint32_t m = json[1];
+  uint32_t s = json.size() == 3 ? json[2].get<uint32_t>() : 0;
+  if (h > 23 || m > 59 || s > 59) {
+    return false;
+  }
+  secs = h * 3600 + m * 60 + s;
+  return true;
+}
+
+}  // namespace
+
+bool nextWindow(const std::vector<Schedule> &schedules,
+                std::chrono::system_clock::time_point now,
+                ScheduleWindow &window) {
+  auto now_t = std::chrono::system_clock::to_time_t(now);
+  struct tm today;
+  localtime_r(&now_t, &today);
+
+  std::vector<ScheduleWindow> windows;
+  for (auto &schedule : schedules) {
+    if (schedule.start == schedule.stop) {
+      continue;
+    }
+    if (schedule.dates.empty()) {
+      // Yesterday's window may still be open; a week covers every weekday.
+      for (int i = -1; i <= 7; ++i) {
+        struct tm day = today;
+        day.tm_mday += i;
+        normalizeDay(day);
+        addWindow(schedule, day, now, windows);
+      }
+    } else {
+      for (auto date : schedule.dates) {
+        struct tm day{};
+        day.tm_year = date / 10000 - 1900;
+        day.tm_mon = date / 100 % 100 - 1;
+        day.tm_mday = date % 100;
+        normalizeDay(day);
+        addWindow(schedule, day, now, windows);
+      }
+    }
+  }
+  if (windows.empty()) {
+    return false;
+  }
+  window = *std::min_element(
+      windows.begin(), windows.end(),
+      [](const ScheduleWindow &a, const ScheduleWindow &b) {
+        return a.start < b.start;
+      });
+  // Extend through the windows that open before this one closes.
+  bool extended = true;
+  while (extended) {
+    extended = false;
+    for (auto &it : windows) {
+      if (it.start <= window.stop && it.stop > window.stop) {
+        window.stop = it.stop;
+        extended = true;
+      }
+    }
+  }
+  return true;
+}
+
+bool parseSchedule(const nlohmann::json &json, Schedule &schedule) {
+  if (!json.is_object() || !json.contains("start") || !json.contains("stop") ||
+      !parseTime(json["start"], schedule.start) ||
+      !parseTime(json["stop"], schedule.stop) ||
+      schedule.start == schedule.stop) {
+    return false;
+  }
+  schedule.weekdays = 0x7F;
+  if (json.contains("weekdays")) {
+    schedule.weekdays = 0;
+    for (auto &it : json["weekdays"]) {
+      if (!it.is_number_unsigned() || it < 1 || it > 7) {
+        return false;
+      }
+      schedule.weekdays |= 1 << (it.get<int>() % 7);
+    }
+    if (!schedule.weekdays) {
+      return false;
+    }
+  }
+  schedule.dates.clear();
+  if (json.contains("dates")) {
+    for (auto &it : json["dates"]) {
+      unsigned y, m, d;
+      if (!it.is_string() ||
+          sscanf(it.get<std::string>().c_str(), "%4u-%2u-%2u", &y, &m, &d) !=
+              3 ||
+          m < 1 || m > 12 || d < 1 || d > 31) {
+        return false;
+      }
+      schedule.dates.push_back(y * 10000 + m * 100 + d);
+    }
+  }
+  return true;
+}
+
+std::string describeSchedule(const Schedule &schedule) {
+  auto out = fmt::format(
+      "{:02d}:{:02d}:{:02d} - {:02d}:{:02d}:{:02d}", schedule.start / 3600,
+      schedule.start / 60 % 60, schedule.start % 60, schedule.stop / 3600,
+      schedule.stop / 60 % 60, schedule.stop % 60);
+  if (schedule.weekdays != 0x7F) {
+    auto sep = " on ";
+    for (int i = 1; i <= 7; ++i) {
+      if (schedule.weekdays & (1 << (i % 7))) {
+        out.append(sep).append(std::to_string(i));
+        sep = ",";
+      }
+    }
+  }
+  auto sep = " on ";
+  for (auto date : schedule.dates) {
+    out += fmt::format("{}{}-{:02d}-{:02d}", sep, date / 10000,
+                       date / 100 % 100, date % 100);
+    sep = ",";
+  }
+  return out;
+}
+
+}  // namespace ddshop
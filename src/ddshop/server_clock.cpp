@@ -0,0 +1,280 @@
+#include "server_clock.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+#include "metrics.hpp"
+#include "spdlog/spdlog.h"
+
+namespace ddshop {
+
+namespace {
+
+// Samples in use, the most recent ones.
+const size_t MAX_SAMPLES = 32;
+// How fast the local and server clocks may drift apart, the value NTP
+// assumes. Older samples widen by this much per second of age.
+const int64_t MAX_DRIFT_PPM = 15;
+// The estimate is logged whenever it moves by more than this.
+const int64_t LOG_SHIFT_NS = 100000000;
+
+// Bounds of the offset from one response, as server wall clock minus local
+// steady clock so the estimate survives local clock steps.
+struct Sample {
+  int64_t received;
+  int64_t lo;
+  int64_t hi;
+  int64_t rtt;
+};
+
+struct ClockState {
+  std::mutex mutex;
+  std::array<Sample, MAX_SAMPLES> samples;
+  size_t next = 0;
+  size_t size = 0;
+  uint64_t total = 0;
+  // The estimate as of the newest sample.
+  int64_t received = 0;
+  int64_t uncertainty = 0;
+  int64_t rtt = 0;
+  size_t agreeing = 0;
+  bool logged = false;
+  int64_t logged_offset = 0;
+
+  std::atomic<bool> valid{false};
+  std::atomic<int64_t> offset{0};
+};
+
+int64_t sinceEpoch(std::chrono::steady_clock::time_point t) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             t.time_since_epoch())
+      .count();
+}
+
+int64_t sinceEpoch(std::chrono::system_clock::time_point t) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             t.time_since_epoch())
+      .count();
+}
+
+// Local wall clock minus local steady clock, right now.
+int64_t wallMinusSteady() {
+  auto steady = std::chrono::steady_clock::now();
+  auto wall = std::chrono::system_clock::now();
+  return sinceEpoch(wall) - sinceEpoch(steady);
+}
+
+ClockState &state();
+
+ServerClock snapshot(ClockState &clock, int64_t now) {
+  ServerClock ret;
+  ret.valid = clock.valid;
+  ret.samples = clock.size;
+  if (!ret.valid) {
+    return ret;
+  }
+  ret.offset =
+      std::chrono::nanoseconds(clock.offset.load() - wallMinusSteady());
+  ret.uncertainty = std::chrono::nanoseconds(
+      clock.uncertainty +
+      std::max<int64_t>(now - clock.received, 0) / 1000000 * MAX_DRIFT_PPM);
+  ret.rtt = std::chrono::nanoseconds(clock.rtt);
+  ret.agreeing = clock.agreeing;
+  return ret;
+}
+
+void collect(std::string &out) {
+  auto &clock = state();
+  ServerClock estimate;
+  uint64_t total;
+  {
+    std::lock_guard<std::mutex> lck(clock.mutex);
+    estimate =
+        snapshot(clock, sinceEpoch(std::chrono::steady_clock::now()));
+    total = clock.total;
+  }
+  out.append(
+         "# HELP ddshop_server_clock_samples_total Responses whose Date "
+         "header was used to estimate the server clock.\n"
+         "# TYPE ddshop_server_clock_samples_total counter\n"
+         "ddshop_server_clock_samples_total ")
+      .append(std::to_string(total))
+      .append("\n");
+  if (!estimate.valid) {
+    return;
+  }
+  auto seconds = [](std::chrono::nanoseconds ns) {
+    return std::to_string(ns.count() / 1e9);
+  };
+  out.append(
+         "# HELP ddshop_server_clock_offset_seconds Server wall clock minus "
+         "local wall clock.\n"
+         "# TYPE ddshop_server_clock_offset_seconds gauge\n"
+         "ddshop_server_clock_offset_seconds ")
+      .append(seconds(estimate.offset))
+      .append(
+          "\n# HELP ddshop_server_clock_uncertainty_seconds The server "
+          "clock offset is known to within this much either way.\n"
+          "# TYPE ddshop_server_clock_uncertainty_seconds gauge\n"
+          "ddshop_server_clock_uncertainty_seconds ")
+      .append(seconds(estimate.uncertainty))
+      .append(
+          "\n# HELP ddshop_server_rtt_seconds Shortest round trip among the "
+          "server clock samples.\n"
+          "# TYPE ddshop_server_rtt_seconds gauge\n"
+          "ddshop_server_rtt_seconds ")
+      .append(seconds(estimate.rtt))
+      .append("\n");
+}
+
+ClockState &state() {
+  static auto instance = []() {
+    auto clock = new ClockState;
+    addMetricsCollector(collect);
+    return clock;
+  }();
+  return *instance;
+}
+
+// Marzullo's algorithm: the smallest interval the most samples agree on,
+// with older samples widened by the drift they may have accumulated. A
+// server behind a balancer with a few skewed backends is outvoted.
+void estimate(ClockState &clock, int64_t now) {
+  std::array<std::pair<int64_t, int>, MAX_SAMPLES * 2> edges;
+  size_t n = 0;
+  int64_t rtt = INT64_MAX;
+  for (size_t i = 0; i < clock.size; ++i) {
+    auto &sample = clock.samples[i];
+    auto widen =
+        std::max<int64_t>(now - sample.received, 0) / 1000000 * MAX_DRIFT_PPM;
+    // Starts sort before ends at the same offset, so touching intervals
+    // agree.
+    edges[n++] = std::make_pair(sample.lo - widen, -1);
+    edges[n++] = std::make_pair(sample.hi + widen, 1);
+    rtt = std::min(rtt, sample.rtt);
+  }
+  std::sort(edges.begin(), edges.begin() + n);
+  int count = 0;
+  int best = 0;
+  int64_t lo = 0;
+  int64_t hi = 0;
+  for (size_t i = 0; i + 1 < n; ++i) {
+    count -= edges[i].second;
+    if (count > best) {
+      best = count;
+      lo = edges[i].first;
+      hi = edges[i + 1].first;
+    }
+  }
+  clock.received = now;
+  clock.uncertainty = (hi - lo) / 2;
+  clock.rtt = rtt;
+  clock.agreeing = best;
+  clock.offset = lo + (hi - lo) / 2;
+  clock.valid = true;
+}
+
+// Days from 1970-01-01 to the given civil date.
+int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  auto era = (y >= 0 ? y : y - 399) / 400;
+  auto yoe = static_cast<unsigned>(y - era * 400);
+  auto doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  auto doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+}  // namespace
+
+bool parseHttpDate(const std::string &date,
+                   std::chrono::system_clock::time_point &out) {
+  static const char *MONTHS[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                 "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+  char month_name[4];
+  int day, year, hour, minute, second;
+  if (sscanf(date.c_str(), "%*3s, %2d %3s %4d %2d:%2d:%2d GMT", &day,
+             month_name, &year, &hour, &minute, &second) != 6) {
+    return false;
+  }
+  unsigned month = 0;
+  while (month < 12 && strcmp(month_name, MONTHS[month]) != 0) {
+    ++month;
+  }
+  if (month == 12 || day < 1 || day > 31 || hour < 0 || hour > 23 ||
+      minute < 0 || minute > 59 || second < 0 || second > 60) {
+    return false;
+  }
+  auto seconds = daysFromCivil(year, month + 1, day) * 86400 + hour * 3600 +
+                 minute * 60 + second;
+  out = std::chrono::system_clock::time_point(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+          std::chrono::seconds(seconds)));
+  return true;
+}
+
+void recordServerDate(const std::string &date,
+                      std::chrono::steady_clock::time_point sent,
+                      std::chrono::steady_clock::time_point received) {
+  std::chrono::system_clock::time_point server;
+  if (received < sent || !parseHttpDate(date, server)) {
+    return;
+  }
+  // The server stamped the response somewhere between sent and received,
+  // and the header drops the fraction of its second.
+  Sample sample;
+  sample.received = sinceEpoch(received);
+  sample.lo = sinceEpoch(server) - sample.received;
+  sample.hi = sinceEpoch(server) + 1000000000 - sinceEpoch(sent);
+  sample.rtt = sample.received - sinceEpoch(sent);
+
+  auto &clock = state();
+  ServerClock logged;
+  {
+    std::lock_guard<std::mutex> lck(clock.mutex);
+    clock.samples[clock.next] = sample;
+    clock.next = (clock.next + 1) % MAX_SAMPLES;
+    clock.size = std::min(clock.size + 1, MAX_SAMPLES);
+    ++clock.total;
+    estimate(clock, sample.received);
+    auto current = snapshot(clock, sample.received);
+    if (!clock.logged ||
+        std::abs(current.offset.count() - clock.logged_offset) >
+            LOG_SHIFT_NS) {
+      clock.logged = true;
+      clock.logged_offset = current.offset.count();
+      logged = current;
+    }
+  }
+  if (logged.valid) {
+    spdlog::info(
+        "Server clock is {:+.3f}s off the local clock, within {:.3f}s, "
+        "{}/{} samples agree, rtt {:.1f}ms",
+        logged.offset.count() / 1e9, logged.uncertainty.count() / 1e9,
+        logged.agreeing, logged.samples, logged.rtt.count() / 1e6);
+  }
+}
+
+ServerClock serverClock() {
+  auto &clock = state();
+  std::lock_guard<std::mutex> lck(clock.mutex);
+  return snapshot(clock, sinceEpoch(std::chrono::steady_clock::now()));
+}
+
+std::chrono::system_clock::time_point serverNow() {
+  auto &clock = state();
+  if (!clock.valid) {
+    return std::chrono::system_clock::now();
+  }
+  return std::chrono::system_clock::time_point(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(
+          std::chrono::steady_clock::now().time_since_epoch() +
+          std::chrono::nanoseconds(clock.offset.load())));
+}
+
+}  // namespace ddshop
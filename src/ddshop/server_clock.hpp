@@ -0,0 +1,37 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+namespace ddshop {
+
+struct ServerClock {
+  bool valid = false;
+  // Server wall clock minus local wall clock.
+  std::chrono::nanoseconds offset{0};
+  // The offset is known to within this much either way.
+  std::chrono::nanoseconds uncertainty{0};
+  // Shortest round trip among the samples in use.
+  std::chrono::nanoseconds rtt{0};
+  // Samples the estimate agrees with, out of those in use.
+  size_t agreeing = 0;
+  size_t samples = 0;
+};
+
+// Adds the Date header of a response as a clock sample. The request was
+// written no earlier than sent and the headers arrived at received.
+void recordServerDate(const std::string &date,
+                      std::chrono::steady_clock::time_point sent,
+                      std::chrono::steady_clock::time_point received);
+
+ServerClock serverClock();
+
+// The local wall clock corrected by the estimated offset, or the local wall
+// clock itself until the first sample.
+std::chrono::system_clock::time_point serverNow();
+
+// Parses an IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT".
+bool parseHttpDate(const std::string &date,
+                   std::chrono::system_clock::time_point &out);
+
+}  // namespace ddshop
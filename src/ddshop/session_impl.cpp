@@ -1,16 +1,53 @@
 #include "session_impl.hpp"
 
+#include "flight_recorder.hpp"
 #include "spdlog/spdlog.h"
+#include "transport.hpp"
 
 namespace ddshop {
 
+constexpr const char *SessionImpl::FORM_CONTENT_TYPE;
+
 SessionImpl::SessionImpl(SessionConfig config)
-    : config_(std::move(config)), client_("https://maicai.api.ddxq.mobi") {
+    : config_(std::move(config)),
+      resolver_(config_.hosts_file),
+      api_pool_(config_.base_url.empty() ? "https://maicai.api.ddxq.mobi"
+                                         : config_.base_url,
+                config_.pool_size,
+                [](httplib::Client &client) {
+                  client.set_connection_timeout(
+                      std::chrono::milliseconds(500));
+                  client.set_read_timeout(std::chrono::milliseconds(2000));
+                  client.set_write_timeout(std::chrono::milliseconds(2000));
+                },
+                poolResolver()),
+      user_pool_(config_.base_url.empty() ? "https://sunquan.api.ddxq.mobi"
+                                          : config_.base_url,
+                 1, nullptr, poolResolver()) {
   if (config_.cookie.empty()) {
     spdlog::error("Cookie should not be empty");
     throw std::runtime_error("Empty cookie");
   }
-  spdlog::info("Initializing session with cookie {}", config_.cookie);
+  spdlog::info("Initializing session with cookie {}, {} pooled connections",
+               config_.cookie, config_.pool_size);
+  if (!config_.base_url.empty()) {
+    spdlog::warn("Using API base url {}", config_.base_url);
+  }
+  setSlowRequestThreshold(std::chrono::milliseconds(config_.slow_request_ms));
+  if (!config_.flight_recorder_dir.empty()) {
+    openFlightRecorder(config_.flight_recorder_dir, FLIGHT_RING_BYTES);
+  }
+  if (!config_.replay_cassette.empty()) {
+    player_.reset(new CassettePlayer);
+    if (!player_->load(config_.replay_cassette, !config_.replay_fast)) {
+      throw std::runtime_error("Invalid cassette");
+    }
+  } else if (!config_.record_cassette.empty()) {
+    recorder_.reset(new CassetteRecorder);
+    if (!recorder_->open(config_.record_cassette)) {
+      recorder_.reset();
+    }
+  }
 
   base_headers_.clear();
   base_headers_.emplace("cookie", "DDXQSESSID=" + config_.cookie);
@@ -22,6 +59,9 @@ SessionImpl::SessionImpl(SessionConfig config)
       "MicroMessenger/6.8.0(0x16080000) NetType/WIFI Language/en "
       "Branch/Br_trunk MiniProgramEnv/Mac");
   base_headers_.emplace("accept", "application/json, text/plain, */*");
+  if (config_.compression) {
+    base_headers_.emplace("accept-encoding", "gzip, deflate");
+  }
   base_headers_.emplace("origin", "https://wx.m.ddxq.mobi");
   base_headers_.emplace("sec-fetch-site", "same-site");
   base_headers_.emplace("sec-fetch-mode", "cors");
@@ -51,37 +91,147 @@ SessionImpl::SessionImpl(SessionConfig config)
   base_params_.emplace("nars", "");
   base_params_.emplace("sesi", "");
 
-  client_.set_connection_timeout(std::chrono::milliseconds(500));
-  client_.set_read_timeout(std::chrono::milliseconds(2000));
-  client_.set_write_timeout(std::chrono::milliseconds(2000));
+  rebuildBaseRequest();
 }
 
 bool SessionImpl::ensureBasicResp(const std::string &str, nlohmann::json &out) {
   out = nlohmann::json::parse(str, nullptr, false);
   if (out.is_discarded()) {
     spdlog::error("JSON parse error");
-    spdlog::debug("{}", str);
     return false;
   }
   if (!out.contains("success") || !out["success"].is_boolean()) {
     spdlog::error("JSON invalid: no success field");
-    spdlog::debug("{}", str);
     return false;
   }
   if (!out["success"] && (!out.contains("code") || !out["code"].is_number() ||
                           !out.contains("msg") || !out["msg"].is_string())) {
     spdlog::error("JSON not success, but invalid code or msg");
-    spdlog::debug("{}", str);
     return false;
   }
   if (out["success"] && !out.contains("data")) {
     spdlog::error("JSON success, but no data");
-    spdlog::debug("{}", str);
     return false;
   }
   return true;
 }
 
+httplib::Result SessionImpl::get(ClientPool &pool, RequestClass cls,
+                                 std::string &path, RequestTimer &timer) {
+  httplib::Request req;
+  req.method = "GET";
+  req.path.swap(path);
+  auto res = send(pool, cls, req, timer);
+  path.swap(req.path);
+  return res;
+}
+
+httplib::Result SessionImpl::post(ClientPool &pool, RequestClass cls,
+                                  const char *path, std::string &body,
+                                  RequestTimer &timer) {
+  httplib::Request req;
+  req.method = "POST";
+  req.path = path;
+  req.body.swap(body);
+  req.headers.emplace("Content-Type", FORM_CONTENT_TYPE);
+  auto res = send(pool, cls, req, timer);
+  body.swap(req.body);
+  return res;
+}
+
+httplib::Result SessionImpl::send(ClientPool &pool, RequestClass cls,
+                                  httplib::Request &req, RequestTimer &timer) {
+  if (player_) {
+    return player_->play(timer.endpoint());
+  }
+  auto res = pool.send(cls, req, timer.phases());
+  recordExchange(timer.endpoint(), timer.elapsed(), req, res);
+  if (recorder_) {
+    recorder_->append(timer.endpoint(), timer.elapsed(), req, res);
+  }
+  return res;
+}
+
+void SessionImpl::rebuildBaseRequest() {
+  base_query_ = httplib::detail::params_to_query_str(base_params_);
+  api_pool_.setDefaultHeaders(base_headers_);
+
+  auto user_headers = base_headers_;
+  user_headers.erase("Host");
+  user_headers.emplace("Host", "sunquan.api.ddxq.mobi");
+  user_pool_.setDefaultHeaders(user_headers);
+}
+
+void SessionImpl::clearCart() {
+  cart_.update([](const CartSnapshot &current, CartSnapshot &) {
+    return current.cart || !current.reserve_time.empty();
+  });
+}
+
+void SessionImpl::clearReserveTime() {
+  cart_.update([](const CartSnapshot &current, CartSnapshot &next) {
+    next.cart = current.cart;
+    return !current.reserve_time.empty();
+  });
+}
+
+void SessionImpl::logStats() {
+  for (size_t i = 0; i < static_cast<size_t>(RequestClass::COUNT); ++i) {
+    auto cls = static_cast<RequestClass>(i);
+    auto stats = api_pool_.laneStats(cls);
+    if (stats.count == 0) {
+      continue;
+    }
+    spdlog::info("Lane {}: {} requests, avg wait {:.3f}ms, max wait {:.3f}ms",
+                 requestClassName(cls), stats.count,
+                 stats.total_wait_ns / 1e6 / stats.count,
+                 stats.max_wait_ns / 1e6);
+  }
+  for (size_t i = 0; i < static_cast<size_t>(Endpoint::COUNT); ++i) {
+    auto endpoint = static_cast<Endpoint>(i);
+    auto latency = requestLatency(endpoint);
+    if (latency.count == 0) {
+      continue;
+    }
+    spdlog::info("{}: {} requests, p50 {:.1f}ms, p99 {:.1f}ms",
+                 endpointName(endpoint), latency.count,
+                 latency.quantile(0.5) / 1e3, latency.quantile(0.99) / 1e3);
+    auto bodies = responseBodies(endpoint);
+    if (bodies.compressed > 0) {
+      spdlog::info(
+          "{}: {}/{} responses compressed, {:.1f}KB on the wire for "
+          "{:.1f}KB, decode {:.1f}ms",
+          endpointName(endpoint), bodies.compressed, bodies.responses,
+          bodies.wire_bytes / 1024.0, bodies.body_bytes / 1024.0,
+          bodies.decode_ns / 1e6);
+    }
+  }
+  auto tls = tlsStats();
+  if (tls.full + tls.resumed > 0) {
+    spdlog::info(
+        "TLS: {} full handshakes avg {:.1f}ms, {} resumed avg {:.1f}ms, "
+        "{:.1f}ms saved",
+        tls.full, tls.full ? tls.full_ns / 1e6 / tls.full : 0.0, tls.resumed,
+        tls.resumed ? tls.resumed_ns / 1e6 / tls.resumed : 0.0,
+        tls.savedNs() / 1e6);
+  }
+}
+
+WarmupReport SessionImpl::warmUp() {
+  WarmupReport report;
+  report.pool_size = api_pool_.size() + user_pool_.size();
+  // A replayed session has no connections to open.
+  report.connections = player_ ? report.pool_size
+                               : api_pool_.warmUp("/") + user_pool_.warmUp("/");
+  report.cart = cartCheckAll() && getCart() && cart_.load()->cart;
+  return report;
+}
+
+void SessionImpl::cancel() {
+  api_pool_.cancel();
+  user_pool_.cancel();
+}
+
 std::shared_ptr<Session> Session::buildSession(SessionConfig config) {
   return std::make_shared<SessionImpl>(std::move(config));
 }
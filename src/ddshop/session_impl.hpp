@@ -1,8 +1,11 @@
 #pragma once
-#include <mutex>
-
+#include "cassette.hpp"
+#include "client_pool.hpp"
 #include "ddshop/session.hpp"
-#include "httplib.h"
+#include "form_buffer.hpp"
+#include "metrics.hpp"
+#include "resolver.hpp"
+#include "snapshot_cell.hpp"
 
 namespace ddshop {
 
@@ -15,26 +18,68 @@ class SessionImpl : public Session {
   bool cartCheckAll() override;
   bool getCart() override;
   bool refreshReserveTime() override;
-  void getReserveTime(std::vector<std::pair<uint64_t, uint64_t>> &out) override;
-  bool checkOrder(const std::pair<uint64_t, uint64_t> &reserve_time,
+  std::shared_ptr<const CartSnapshot> getSnapshot() override;
+  bool checkOrder(const std::shared_ptr<const CartSnapshot> &snapshot,
+                  const std::pair<uint64_t, uint64_t> &reserve_time,
                   Order &order, int &code) override;
   bool doOrder(Order &order, int &code) override;
   int hasUnpaidOrder() override;
+  void logStats() override;
+  WarmupReport warmUp() override;
+  void cancel() override;
+
+  // The parsing and request building steps of the calls above, public so
+  // ddshop_bench can time them on their own.
+  static bool ensureBasicResp(const std::string &, nlohmann::json &);
+  static bool parseCart(const nlohmann::json &data, Cart &cart);
+  // Both build into this thread's form buffer.
+  std::string &checkOrderBody(
+      const Cart &cart, const std::pair<uint64_t, uint64_t> &reserve_time);
+  std::string &doOrderBody(const Order &order);
+  // Fills the order fields addNewOrder needs from checkOrder's data.
+  void checkOrderData(nlohmann::json &data, const Cart &cart,
+                      const std::pair<uint64_t, uint64_t> &reserve_time,
+                      nlohmann::json &out);
 
  private:
   const std::string API_VERSION = "9.49.2";
   const std::string APP_VERSION = "2.82.0";
+  static constexpr const char *FORM_CONTENT_TYPE =
+      "application/x-www-form-urlencoded";
+  // Per worker, holds several minutes of peak time traffic.
+  const size_t FLIGHT_RING_BYTES = 32 * 1024 * 1024;
 
   SessionConfig config_;
-  httplib::Client client_;
+  Resolver resolver_;
+  ClientPool api_pool_;
+  ClientPool user_pool_;
   httplib::Headers base_headers_;
   httplib::Params base_params_;
+  // base_params_ URL-encoded once; base_headers_ are installed as the
+  // pools' default headers. Both are rebuilt by rebuildBaseRequest().
+  std::string base_query_;
 
-  std::mutex cart_mutex_;
-  nlohmann::json cart_data_;
-  std::vector<std::pair<uint64_t, uint64_t>> reserve_time_;
+  SnapshotCell<CartSnapshot> cart_;
 
-  static bool ensureBasicResp(const std::string &, nlohmann::json &);
+  std::unique_ptr<CassetteRecorder> recorder_;
+  std::unique_ptr<CassettePlayer> player_;
+
+  // The resolver for the pools, none when replaying a cassette.
+  Resolver *poolResolver() {
+    return config_.replay_cassette.empty() ? &resolver_ : nullptr;
+  }
+  // path and body are swapped into the request and back after the send,
+  // so the thread's form buffer keeps its capacity and is never copied.
+  httplib::Result get(ClientPool &pool, RequestClass cls, std::string &path,
+                      RequestTimer &timer);
+  httplib::Result post(ClientPool &pool, RequestClass cls, const char *path,
+                       std::string &body, RequestTimer &timer);
+  httplib::Result send(ClientPool &pool, RequestClass cls,
+                       httplib::Request &req, RequestTimer &timer);
+
+  void rebuildBaseRequest();
+  void clearCart();
+  void clearReserveTime();
 };
 
 }  // namespace ddshop
@@ -0,0 +1,86 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace ddshop {
+
+// Holds the current version of an immutable value. Writers derive the next
+// version from the current one and swap it in, retrying if another writer
+// won the race.
+//
+// The atomic shared_ptr functions take a global hashed mutex in libstdc++,
+// so readers only go through them once per published version. In between
+// each thread reuses the snapshot it cached, checked against a plain
+// atomic version, and takes no lock.
+template <typename T>
+class SnapshotCell {
+ public:
+  SnapshotCell()
+      : ptr_(std::make_shared<const T>()), id_(nextId()), version_(0) {}
+
+  std::shared_ptr<const T> load() const {
+    auto version = version_.load(std::memory_order_acquire);
+    auto &cache = cache_;
+    if (cache.id != id_ || cache.version != version) {
+      cache.ptr = std::atomic_load_explicit(&ptr_, std::memory_order_acquire);
+      cache.id = id_;
+      // May be ahead of version when a writer has not published it yet.
+      cache.version = cache.ptr->version;
+    }
+    return cache.ptr;
+  }
+
+  // fn(const T &current, T &next) fills next and returns false to keep the
+  // current version. Returns the version in effect afterwards.
+  template <typename Fn>
+  std::shared_ptr<const T> update(Fn &&fn) {
+    auto current = std::atomic_load_explicit(&ptr_, std::memory_order_acquire);
+    while (true) {
+      auto next = std::make_shared<T>();
+      if (!fn(*current, *next)) {
+        return current;
+      }
+      next->version = current->version + 1;
+      std::shared_ptr<const T> published = std::move(next);
+      if (std::atomic_compare_exchange_strong_explicit(
+              &ptr_, &current, published, std::memory_order_acq_rel,
+              std::memory_order_acquire)) {
+        // Racing writers may get here out of order, never move it back.
+        auto version = version_.load(std::memory_order_relaxed);
+        while (version < published->version &&
+               !version_.compare_exchange_weak(version, published->version,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+        }
+        return published;
+      }
+    }
+  }
+
+ private:
+  // One entry per thread and T, a thread reading several cells of the same
+  // T reloads whenever it switches between them. Cells are told apart by
+  // id, as a new cell may reuse the address of a destroyed one.
+  struct Cache {
+    uint64_t id = 0;
+    uint64_t version = 0;
+    std::shared_ptr<const T> ptr;
+  };
+
+  static uint64_t nextId() {
+    static std::atomic<uint64_t> next{1};
+    return next.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::shared_ptr<const T> ptr_;
+  const uint64_t id_;
+  std::atomic<uint64_t> version_;
+
+  static thread_local Cache cache_;
+};
+
+template <typename T>
+thread_local typename SnapshotCell<T>::Cache SnapshotCell<T>::cache_;
+
+}  // namespace ddshop
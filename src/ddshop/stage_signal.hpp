@@ -0,0 +1,59 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace ddshop {
+
+// Wakes the waiters of a pipeline stage as soon as an upstream stage
+// publishes, instead of having them poll. Each waiter keeps the sequence
+// number it has seen, so one notify wakes every waiter exactly once.
+class StageSignal {
+ public:
+  uint64_t sequence() {
+    std::lock_guard<std::mutex> lck(mutex_);
+    return seq_;
+  }
+
+  void notify() {
+    {
+      std::lock_guard<std::mutex> lck(mutex_);
+      ++seq_;
+    }
+    cv_.notify_all();
+  }
+
+  // Releases all waiters until reset(), used when stopping.
+  void interrupt() {
+    {
+      std::lock_guard<std::mutex> lck(mutex_);
+      interrupted_ = true;
+    }
+    cv_.notify_all();
+  }
+
+  void reset() {
+    std::lock_guard<std::mutex> lck(mutex_);
+    interrupted_ = false;
+  }
+
+  // Blocks until notified, interrupted or the deadline passes. Returns true
+  // if woken by a notify.
+  bool waitUntil(std::chrono::steady_clock::time_point deadline,
+                 uint64_t &seen) {
+    std::unique_lock<std::mutex> lck(mutex_);
+    cv_.wait_until(lck, deadline,
+                   [this, &seen]() { return interrupted_ || seq_ != seen; });
+    auto notified = seq_ != seen;
+    seen = seq_;
+    return notified;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  uint64_t seq_ = 0;
+  bool interrupted_ = false;
+};
+
+}  // namespace ddshop
@@ -0,0 +1,61 @@
+#include "thread_registry.hpp"
+
+#include <unordered_map>
+
+#include "spdlog/details/os.h"
+
+namespace ddshop {
+
+namespace {
+
+thread_local std::string current_name = "other";
+thread_local uint64_t current_version = 0;
+
+struct ThreadNames {
+  std::mutex mutex;
+  // Thread ids are reused by the OS, a new name replaces the old one.
+  std::unordered_map<size_t, std::string> names;
+  std::vector<std::function<void()>> hooks;
+};
+
+ThreadNames &threadNames() {
+  static auto instance = new ThreadNames;
+  return *instance;
+}
+
+}  // namespace
+
+void setThreadName(const std::string &name) {
+  current_name = name;
+  ++current_version;
+  auto &names = threadNames();
+  std::vector<std::function<void()>> hooks;
+  {
+    std::lock_guard<std::mutex> lck(names.mutex);
+    names.names[spdlog::details::os::thread_id()] = name;
+    hooks = names.hooks;
+  }
+  // Outside the lock, hooks may take other locks or log.
+  for (auto &hook : hooks) {
+    hook();
+  }
+}
+
+const std::string &threadName() { return current_name; }
+
+uint64_t threadNameVersion() { return current_version; }
+
+std::string threadNameOf(size_t thread_id) {
+  auto &names = threadNames();
+  std::lock_guard<std::mutex> lck(names.mutex);
+  auto it = names.names.find(thread_id);
+  return it == names.names.end() ? std::string() : it->second;
+}
+
+void addThreadNameHook(std::function<void()> hook) {
+  auto &names = threadNames();
+  std::lock_guard<std::mutex> lck(names.mutex);
+  names.hooks.push_back(std::move(hook));
+}
+
+}  // namespace ddshop
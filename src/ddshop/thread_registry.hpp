@@ -0,0 +1,98 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ddshop {
+
+// Names the calling thread, e.g. "order-0", for its metrics shard, trace
+// buffer, flight recorder ring and log views. Threads sharing a name share
+// those entries; unnamed threads use the ones named "other".
+void setThreadName(const std::string &name);
+
+// The name of the calling thread.
+const std::string &threadName();
+
+// Bumped on the calling thread by every setThreadName().
+uint64_t threadNameVersion();
+
+// The name set by the thread with spdlog thread id thread_id, or empty.
+std::string threadNameOf(size_t thread_id);
+
+// Runs hook on every thread named after this call, right after
+// setThreadName(), e.g. to set up per-thread state before the thread's
+// first request instead of during it. Hooks stay for the process lifetime.
+void addThreadNameHook(std::function<void()> hook);
+
+// Per-thread state that threads look up once and then use through a raw
+// pointer. Entries are therefore never freed: the list never shrinks and
+// the registry is leaked, so threads still running during static
+// destruction can keep using theirs.
+template <typename T>
+class ThreadRegistry {
+ public:
+  static ThreadRegistry &instance() {
+    static auto instance = new ThreadRegistry;
+    return *instance;
+  }
+
+  // The entry named after the calling thread, looked up again only once
+  // the thread is renamed. T needs a name member and a constructor taking
+  // the name.
+  T &current() {
+    auto version = threadNameVersion();
+    if (!current_ || current_version_ != version) {
+      current_ = &named(threadName());
+      current_version_ = version;
+    }
+    return *current_;
+  }
+
+  T &named(const std::string &name) {
+    return find([&name](T &it) { return it.name == name; },
+                [&name]() { return new T(name); });
+  }
+
+  // The first entry pred accepts, or a new one from make() if none does.
+  // Both run under the registry lock, so pred may claim the entry.
+  template <typename Pred, typename Make>
+  T &find(Pred &&pred, Make &&make) {
+    std::lock_guard<std::mutex> lck(mutex_);
+    for (auto &it : entries_) {
+      if (pred(*it)) {
+        return *it;
+      }
+    }
+    entries_.emplace_back(make());
+    return *entries_.back();
+  }
+
+  // Calls fn on every entry in creation order under the registry lock.
+  template <typename Fn>
+  void forEach(Fn &&fn) {
+    std::lock_guard<std::mutex> lck(mutex_);
+    for (auto &it : entries_) {
+      fn(*it);
+    }
+  }
+
+ private:
+  ThreadRegistry() = default;
+
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<T>> entries_;
+
+  static thread_local T *current_;
+  static thread_local uint64_t current_version_;
+};
+
+template <typename T>
+thread_local T *ThreadRegistry<T>::current_ = nullptr;
+
+template <typename T>
+thread_local uint64_t ThreadRegistry<T>::current_version_ = 0;
+
+}  // namespace ddshop
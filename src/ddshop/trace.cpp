@@ -0,0 +1,124 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "spdlog/spdlog.h"
+#include "thread_registry.hpp"
+
+namespace ddshop {
+
+namespace {
+
+// An order worker records a handful of spans every 100-300ms, so this keeps
+// well over a 4 minute schedule window per thread.
+const size_t RING_CAPACITY = 8192;
+
+struct TraceBuffer {
+  explicit TraceBuffer(std::string name)
+      : name(std::move(name)), events(RING_CAPACITY) {}
+
+  const std::string name;
+  // Only contended while a trace is being exported.
+  std::mutex mutex;
+  std::vector<TraceEvent> events;
+  uint64_t head = 0;
+};
+
+using BufferRegistry = ThreadRegistry<TraceBuffer>;
+
+void appendEvent(std::string &out, const TraceEvent &event, size_t tid) {
+  auto ts_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   event.start.time_since_epoch())
+                   .count();
+  char buf[128];
+  snprintf(buf, sizeof(buf),
+           "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,"
+           "\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+           event.name, tid, ts_ns / 1e3, event.dur_ns / 1e3);
+  out.append(buf);
+  const char *sep = "";
+  if (event.has_slot) {
+    snprintf(buf, sizeof(buf), "\"slot\":\"%llu-%llu\"",
+             static_cast<unsigned long long>(event.slot.first),
+             static_cast<unsigned long long>(event.slot.second));
+    out.append(buf);
+    sep = ",";
+  }
+  if (event.has_code) {
+    snprintf(buf, sizeof(buf), "%s\"code\":%lld", sep,
+             static_cast<long long>(event.code));
+    out.append(buf);
+    sep = ",";
+  }
+  if (event.has_result) {
+    out.append(sep).append(event.ok ? "\"ok\":true" : "\"ok\":false");
+  }
+  out.append("}}");
+}
+
+}  // namespace
+
+void recordTraceEvent(const TraceEvent &event) {
+  auto &buffer = BufferRegistry::instance().current();
+  std::lock_guard<std::mutex> lck(buffer.mutex);
+  buffer.events[buffer.head++ % RING_CAPACITY] = event;
+}
+
+std::string renderChromeTrace() {
+  std::vector<TraceBuffer *> buffers;
+  BufferRegistry::instance().forEach(
+      [&buffers](TraceBuffer &buffer) { buffers.push_back(&buffer); });
+
+  std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  const char *sep = "";
+  std::vector<TraceEvent> events;
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    // Timeline rows in the order the threads first recorded.
+    auto buffer = buffers[i];
+    auto tid = i + 1;
+    out.append(sep)
+        .append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":")
+        .append(std::to_string(tid))
+        .append(",\"args\":{\"name\":")
+        .append(nlohmann::json(buffer->name).dump())
+        .append("}}");
+    sep = ",";
+    {
+      std::lock_guard<std::mutex> lck(buffer->mutex);
+      auto count = std::min<uint64_t>(buffer->head, RING_CAPACITY);
+      events.clear();
+      events.reserve(count);
+      for (auto i = buffer->head - count; i < buffer->head; ++i) {
+        events.push_back(buffer->events[i % RING_CAPACITY]);
+      }
+    }
+    for (auto &it : events) {
+      out.append(",");
+      appendEvent(out, it, tid);
+    }
+  }
+  out.append("]}\n");
+  return out;
+}
+
+bool writeChromeTrace(const std::string &path) {
+  std::ofstream fout(path, std::ios::trunc);
+  if (!fout.good()) {
+    spdlog::error("Failed to open trace file {}", path);
+    return false;
+  }
+  fout << renderChromeTrace();
+  if (!fout.good()) {
+    spdlog::error("Failed to write trace file {}", path);
+    return false;
+  }
+  spdlog::info("Trace written to {}", path);
+  return true;
+}
+
+}  // namespace ddshop
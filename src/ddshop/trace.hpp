@@ -0,0 +1,75 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <utility>
+
+namespace ddshop {
+
+struct TraceEvent {
+  const char *name;
+  std::chrono::steady_clock::time_point start;
+  uint64_t dur_ns;
+  bool has_slot;
+  bool has_code;
+  bool has_result;
+  bool ok;
+  int64_t code;
+  std::pair<uint64_t, uint64_t> slot;
+};
+
+// Appends to the ring buffer of the calling thread's name, see
+// setThreadName(), overwriting the oldest event once it is full. Each name
+// gets its own timeline row.
+void recordTraceEvent(const TraceEvent &event);
+
+// All buffered events in Chrome trace event format, loadable by
+// chrome://tracing and ui.perfetto.dev.
+std::string renderChromeTrace();
+
+bool writeChromeTrace(const std::string &path);
+
+// Records a complete event for the enclosing scope. Spans opened while
+// another is open on the same thread show up as its children.
+class TraceSpan {
+ public:
+  explicit TraceSpan(const char *name) {
+    event_.name = name;
+    event_.start = std::chrono::steady_clock::now();
+  }
+  TraceSpan(const TraceSpan &) = delete;
+  void operator=(const TraceSpan &) = delete;
+  ~TraceSpan() { end(); }
+
+  void setSlot(const std::pair<uint64_t, uint64_t> &slot) {
+    event_.has_slot = true;
+    event_.slot = slot;
+  }
+
+  void setCode(int64_t code) {
+    event_.has_code = true;
+    event_.code = code;
+  }
+
+  void setResult(bool ok) {
+    event_.has_result = true;
+    event_.ok = ok;
+  }
+
+  // Records the span now instead of at the end of the scope.
+  void end() {
+    if (ended_) {
+      return;
+    }
+    ended_ = true;
+    event_.dur_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - event_.start)
+                        .count();
+    recordTraceEvent(event_);
+  }
+
+ private:
+  TraceEvent event_{};
+  bool ended_ = false;
+};
+
+}  // namespace ddshop
@@ -0,0 +1,356 @@
+#include "transport.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <mutex>
+#include <unordered_map>
+
+#include "metrics.hpp"
+#include "server_clock.hpp"
+#include "spdlog/spdlog.h"
+#include "zlib.h"
+
+namespace ddshop {
+
+namespace {
+
+thread_local RequestPhases *active_phases = nullptr;
+
+void markOnce(RequestPhases::TimePoint &point) {
+  if (point == RequestPhases::TimePoint()) {
+    point = std::chrono::steady_clock::now();
+  }
+}
+
+// Inflates gzip and deflate bodies chunk by chunk as they are read, straight
+// into the response body, so the compressed body is never held in full.
+// The stream is reset between responses rather than reallocated.
+class BodyDecoder {
+ public:
+  BodyDecoder() = default;
+  BodyDecoder(const BodyDecoder &) = delete;
+  void operator=(const BodyDecoder &) = delete;
+  ~BodyDecoder() {
+    if (initialized_) {
+      inflateEnd(&stream_);
+    }
+  }
+
+  // False for an encoding other than gzip, deflate or none.
+  bool begin(const std::string &encoding) {
+    started_ = false;
+    finished_ = false;
+    if (encoding.empty() || encoding == "identity") {
+      mode_ = Mode::NONE;
+    } else if (encoding == "gzip" || encoding == "x-gzip") {
+      mode_ = Mode::GZIP;
+    } else if (encoding == "deflate") {
+      mode_ = Mode::DEFLATE;
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  bool compressed() const { return mode_ != Mode::NONE; }
+
+  bool decode(const char *data, size_t n, std::string &out) {
+    if (mode_ == Mode::NONE) {
+      out.append(data, n);
+      return true;
+    }
+    if (!started_ && !start(data, n)) {
+      return false;
+    }
+    stream_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    stream_.avail_in = static_cast<uInt>(n);
+    // Inflating into a chunk and appending leaves growing out to the string,
+    // rather than zero-filling its spare capacity on every call. A full
+    // chunk may leave output pending with no input left. Whatever follows
+    // the end of the stream is ignored.
+    char chunk[CHUNK_SIZE];
+    do {
+      stream_.next_out = reinterpret_cast<Bytef *>(chunk);
+      stream_.avail_out = static_cast<uInt>(CHUNK_SIZE);
+      auto ret = inflate(&stream_, Z_NO_FLUSH);
+      out.append(chunk, CHUNK_SIZE - stream_.avail_out);
+      if (ret == Z_STREAM_END) {
+        finished_ = true;
+      } else if (ret == Z_BUF_ERROR && stream_.avail_in == 0) {
+        // The last chunk was filled exactly, nothing was pending.
+        break;
+      } else if (ret != Z_OK) {
+        spdlog::warn("Decoding the response body failed: {}",
+                     stream_.msg ? stream_.msg : zError(ret));
+        return false;
+      }
+    } while (!finished_ && (stream_.avail_in > 0 || stream_.avail_out == 0));
+    return true;
+  }
+
+  // False if a compressed body ended before its stream did.
+  bool finish() const { return mode_ == Mode::NONE || !started_ || finished_; }
+
+ private:
+  enum class Mode : uint8_t { NONE, GZIP, DEFLATE };
+
+  static const size_t CHUNK_SIZE = 16384;
+
+  z_stream stream_{};
+  bool initialized_ = false;
+  Mode mode_ = Mode::NONE;
+  bool started_ = false;
+  bool finished_ = false;
+
+  bool start(const char *data, size_t n) {
+    int bits = 16 + MAX_WBITS;
+    if (mode_ == Mode::DEFLATE) {
+      // "deflate" should be zlib wrapped, some servers send it raw.
+      auto b0 = static_cast<unsigned char>(data[0]);
+      auto zlib = n >= 2 && (b0 & 0x0F) == Z_DEFLATED &&
+                  (b0 * 256 + static_cast<unsigned char>(data[1])) % 31 == 0;
+      bits = zlib ? MAX_WBITS : -MAX_WBITS;
+    }
+    auto ret = initialized_ ? inflateReset2(&stream_, bits)
+                            : inflateInit2(&stream_, bits);
+    if (ret != Z_OK) {
+      spdlog::warn("Setting up the response decoder failed: {}", zError(ret));
+      return false;
+    }
+    initialized_ = true;
+    started_ = true;
+    return true;
+  }
+};
+
+thread_local BodyDecoder body_decoder;
+
+// The last session issued by each host, offered by every new connection
+// to it whatever client it belongs to.
+struct SessionCache {
+  std::mutex mutex;
+  std::unordered_map<std::string, SSL_SESSION *> sessions;
+  std::atomic<uint64_t> handshakes[2] = {{0}, {0}};
+  std::atomic<uint64_t> handshake_ns[2] = {{0}, {0}};
+};
+
+SessionCache &sessionCache() {
+  static auto instance = new SessionCache;
+  return *instance;
+}
+
+// Handshakes run on the connecting thread from start to done.
+thread_local std::chrono::steady_clock::time_point handshake_start;
+
+// Takes the reference to session, it replaces the one cached for the host.
+int newSessionCallback(SSL *ssl, SSL_SESSION *session) {
+  auto host = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+  if (!host) {
+    return 0;
+  }
+  auto &cache = sessionCache();
+  SSL_SESSION *old;
+  {
+    std::lock_guard<std::mutex> lck(cache.mutex);
+    auto &slot = cache.sessions[host];
+    old = slot;
+    slot = session;
+  }
+  if (old) {
+    SSL_SESSION_free(old);
+  }
+  return 1;
+}
+
+// A new reference to the unexpired session cached for host, or null.
+SSL_SESSION *cachedSession(const char *host) {
+  auto &cache = sessionCache();
+  std::lock_guard<std::mutex> lck(cache.mutex);
+  auto it = cache.sessions.find(host);
+  if (it == cache.sessions.end()) {
+    return nullptr;
+  }
+  auto session = it->second;
+  if (!SSL_SESSION_is_resumable(session) ||
+      SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session) <
+          time(nullptr)) {
+    SSL_SESSION_free(session);
+    cache.sessions.erase(it);
+    return nullptr;
+  }
+  SSL_SESSION_up_ref(session);
+  return session;
+}
+
+void sslInfoCallback(const SSL *ssl, int where, int) {
+  if (where & SSL_CB_HANDSHAKE_START) {
+    // The handshake starts right after the TCP connect completes.
+    if (active_phases) {
+      markOnce(active_phases->connected);
+    }
+    handshake_start = std::chrono::steady_clock::now();
+    // The ClientHello is not written yet, so a session can still be offered.
+    // httplib gives no other hook between SSL_new and SSL_connect.
+    auto mutable_ssl = const_cast<SSL *>(ssl);
+    auto host = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+    if (!SSL_get_session(ssl) && host) {
+      if (auto session = cachedSession(host)) {
+        SSL_set_session(mutable_ssl, session);
+        SSL_SESSION_free(session);
+      }
+    }
+  } else if (where & SSL_CB_HANDSHAKE_DONE) {
+    if (active_phases &&
+        active_phases->connected != RequestPhases::TimePoint()) {
+      markOnce(active_phases->tls_done);
+    }
+    if (handshake_start != std::chrono::steady_clock::time_point()) {
+      auto &cache = sessionCache();
+      auto resumed = SSL_session_reused(ssl) ? 1 : 0;
+      cache.handshakes[resumed].fetch_add(1, std::memory_order_relaxed);
+      cache.handshake_ns[resumed].fetch_add(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - handshake_start)
+              .count(),
+          std::memory_order_relaxed);
+      handshake_start = std::chrono::steady_clock::time_point();
+    }
+  }
+}
+
+void collectTlsStats(std::string &out) {
+  auto stats = tlsStats();
+  auto seconds = [](uint64_t ns) { return std::to_string(ns / 1e9); };
+  out.append(
+         "# HELP ddshop_tls_handshakes_total TLS handshakes, by whether a "
+         "cached session was resumed.\n"
+         "# TYPE ddshop_tls_handshakes_total counter\n"
+         "ddshop_tls_handshakes_total{resumed=\"false\"} ")
+      .append(std::to_string(stats.full))
+      .append("\nddshop_tls_handshakes_total{resumed=\"true\"} ")
+      .append(std::to_string(stats.resumed))
+      .append(
+          "\n# HELP ddshop_tls_handshake_seconds_total Time spent in TLS "
+          "handshakes, by whether a cached session was resumed.\n"
+          "# TYPE ddshop_tls_handshake_seconds_total counter\n"
+          "ddshop_tls_handshake_seconds_total{resumed=\"false\"} ")
+      .append(seconds(stats.full_ns))
+      .append("\nddshop_tls_handshake_seconds_total{resumed=\"true\"} ")
+      .append(seconds(stats.resumed_ns))
+      .append(
+          "\n# HELP ddshop_tls_resumption_saved_seconds_total Handshake time "
+          "saved by resuming, against the average full handshake.\n"
+          "# TYPE ddshop_tls_resumption_saved_seconds_total counter\n"
+          "ddshop_tls_resumption_saved_seconds_total ")
+      .append(seconds(stats.savedNs()))
+      .append("\n");
+}
+
+}  // namespace
+
+uint64_t TlsStats::savedNs() const {
+  if (!full || !resumed) {
+    return 0;
+  }
+  auto saved = static_cast<double>(full_ns) / full * resumed - resumed_ns;
+  return saved > 0 ? static_cast<uint64_t>(saved) : 0;
+}
+
+TlsStats tlsStats() {
+  auto &cache = sessionCache();
+  TlsStats stats;
+  stats.full = cache.handshakes[0].load(std::memory_order_relaxed);
+  stats.resumed = cache.handshakes[1].load(std::memory_order_relaxed);
+  stats.full_ns = cache.handshake_ns[0].load(std::memory_order_relaxed);
+  stats.resumed_ns = cache.handshake_ns[1].load(std::memory_order_relaxed);
+  return stats;
+}
+
+void enableTlsResumption(httplib::Client &client) {
+  static std::once_flag collector;
+  std::call_once(collector, []() { addMetricsCollector(collectTlsStats); });
+  if (auto ctx = client.ssl_context()) {
+    // Clients only resume sessions offered explicitly, OpenSSL's own cache
+    // is for servers.
+    SSL_CTX_set_session_cache_mode(
+        ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx, newSessionCallback);
+    SSL_CTX_set_info_callback(ctx, sslInfoCallback);
+  }
+}
+
+void instrumentClient(httplib::Client &client) {
+  client.set_tcp_nodelay(true);
+  // sendTimed decodes the body itself to measure it.
+  client.set_decompress(false);
+  // Called once the address is resolved, before connecting.
+  client.set_socket_options([](socket_t) {
+    if (active_phases) {
+      markOnce(active_phases->dns_done);
+    }
+  });
+  enableTlsResumption(client);
+}
+
+httplib::Result sendTimed(httplib::Client &client, httplib::Request &req,
+                          RequestPhases &phases) {
+  std::unique_ptr<httplib::Response> res(new httplib::Response);
+  auto &decoder = body_decoder;
+  // Responses without a body never reach the handler.
+  decoder.begin("");
+  req.response_handler = [&phases, &decoder](const httplib::Response &r) {
+    phases.first_byte = std::chrono::steady_clock::now();
+    auto encoding = r.get_header_value("Content-Encoding");
+    if (!decoder.begin(encoding)) {
+      spdlog::warn("Unsupported response encoding {}", encoding);
+      return false;
+    }
+    phases.compressed = decoder.compressed();
+    return true;
+  };
+  req.content_receiver = [&phases, &decoder, &res](const char *data,
+                                                   size_t n, uint64_t,
+                                                   uint64_t) {
+    phases.wire_bytes += n;
+    if (!phases.compressed) {
+      return decoder.decode(data, n, res->body);
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto ok = decoder.decode(data, n, res->body);
+    phases.decode_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+    return ok;
+  };
+  auto error = httplib::Error::Success;
+  active_phases = &phases;
+  auto ok = client.send(req, *res, error);
+  active_phases = nullptr;
+  phases.end = std::chrono::steady_clock::now();
+  phases.body_bytes = res->body.size();
+  if (ok && !decoder.finish()) {
+    spdlog::warn("Compressed response body was cut short");
+    ok = false;
+    error = httplib::Error::Read;
+  }
+  if (!ok) {
+    res.reset();
+    return httplib::Result(std::move(res), error);
+  }
+  if (phases.compressed) {
+    // The body is plain now, e.g. for the flight recorder and cassettes.
+    res->headers.erase("Content-Encoding");
+    res->headers.erase("Content-Length");
+  }
+  if (phases.first_byte != RequestPhases::TimePoint() &&
+      res->has_header("Date")) {
+    // The request went out after the last connection setup step.
+    auto sent = std::max({phases.acquired, phases.dns_done, phases.connected,
+                          phases.tls_done});
+    recordServerDate(res->get_header_value("Date"), sent, phases.first_byte);
+  }
+  return httplib::Result(std::move(res), error);
+}
+
+}  // namespace ddshop
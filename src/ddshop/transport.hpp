@@ -0,0 +1,35 @@
+#pragma once
+#include "httplib.h"
+#include "request_phases.hpp"
+
+namespace ddshop {
+
+struct TlsStats {
+  uint64_t full = 0;
+  uint64_t resumed = 0;
+  uint64_t full_ns = 0;
+  uint64_t resumed_ns = 0;
+
+  // Handshake time the resumed handshakes saved over full ones.
+  uint64_t savedNs() const;
+};
+
+// Installs the hooks that timestamp DNS, connect and TLS handshake of the
+// requests sent through sendTimed on this client, and enables TLS session
+// resumption.
+void instrumentClient(httplib::Client &client);
+
+// New connections of the client resume the last TLS session any client
+// got from the same host, with an abbreviated handshake. No-op for plain
+// HTTP.
+void enableTlsResumption(httplib::Client &client);
+
+TlsStats tlsStats();
+
+// Sends req and fills the remaining phases. Connection setup happens on the
+// calling thread, which is how the client hooks find the phases. The Date
+// header of the response feeds the server clock estimate.
+httplib::Result sendTimed(httplib::Client &client, httplib::Request &req,
+                          RequestPhases &phases);
+
+}  // namespace ddshop
@@ -4,22 +4,23 @@
 namespace ddshop {
 
 bool SessionImpl::initUser() {
-  auto headers = base_headers_;
-  auto tmp_client = httplib::Client("https://sunquan.api.ddxq.mobi");
-  headers.erase("Host");
-  headers.emplace("Host", "sunquan.api.ddxq.mobi");
-  auto resp = tmp_client.Get("/api/v1/user/detail/", base_params_, headers);
+  auto &path = formBuffer("/api/v1/user/detail/", base_query_);
+  RequestTimer timer(Endpoint::USER_DETAIL);
+  auto resp = get(user_pool_, RequestClass::HOUSEKEEPING, path, timer);
   if (resp.error() == httplib::Error::Success) {
     nlohmann::json ret_data;
     if (!ensureBasicResp(resp->body, ret_data)) {
       spdlog::error("Failed parsing user data");
+      timer.setOutcome(Outcome::JSON_ERROR);
       return false;
     }
+    timer.setCode(ret_data["success"] ? 0 : ret_data["code"].get<int64_t>());
     std::string uid = ret_data["data"]["user_info"]["id"];
 
     spdlog::info("User uid: {}", uid);
     base_headers_.emplace("ddmc-uid", uid);
     base_params_.emplace("uid", uid);
+    rebuildBaseRequest();
     return true;
   } else {
     spdlog::error("Failed initializing user");
@@ -0,0 +1,180 @@
+#include "log_panel.hpp"
+
+#include <QColor>
+#include <QFontDatabase>
+#include <QHBoxLayout>
+#include <QScrollBar>
+#include <QVBoxLayout>
+
+#include "ddshop/logging.hpp"
+
+LogPanelSink::LogPanelSink(size_t capacity) : capacity_(capacity) {
+  set_pattern_("%H:%M:%S.%e [%l] %v");
+}
+
+void LogPanelSink::take(std::vector<LogEntry> &out) {
+  std::lock_guard<std::mutex> lck(mutex_);
+  out.assign(std::make_move_iterator(pending_.begin()),
+             std::make_move_iterator(pending_.end()));
+  pending_.clear();
+}
+
+void LogPanelSink::sink_it_(const spdlog::details::log_msg &msg) {
+  spdlog::memory_buf_t formatted;
+  formatter_->format(msg, formatted);
+  auto len = formatted.size();
+  while (len > 0 &&
+         (formatted[len - 1] == '\n' || formatted[len - 1] == '\r')) {
+    --len;
+  }
+  if (pending_.size() == capacity_) {
+    pending_.pop_front();
+  }
+  LogEntry entry;
+  entry.level = msg.level;
+  auto worker = ddshop::logThreadName(msg.thread_id);
+  entry.worker = QString::fromStdString(worker.empty() ? "other" : worker);
+  entry.text = QString::fromUtf8(formatted.data(), static_cast<int>(len));
+  pending_.emplace_back(std::move(entry));
+}
+
+LogModel::LogModel(size_t capacity, QObject *parent)
+    : QAbstractListModel(parent), ring_(capacity) {}
+
+int LogModel::rowCount(const QModelIndex &parent) const {
+  return parent.isValid() ? 0 : static_cast<int>(size_);
+}
+
+QVariant LogModel::data(const QModelIndex &index, int role) const {
+  if (!index.isValid() || static_cast<size_t>(index.row()) >= size_) {
+    return QVariant();
+  }
+  auto &entry = at(index.row());
+  switch (role) {
+    case Qt::DisplayRole:
+      return entry.text;
+    case Qt::ForegroundRole:
+      if (entry.level >= spdlog::level::err) {
+        return QColor(Qt::red);
+      } else if (entry.level == spdlog::level::warn) {
+        return QColor(200, 120, 0);
+      } else if (entry.level <= spdlog::level::debug) {
+        return QColor(Qt::gray);
+      }
+      return QVariant();
+    case LEVEL_ROLE:
+      return static_cast<int>(entry.level);
+    case WORKER_ROLE:
+      return entry.worker;
+    default:
+      return QVariant();
+  }
+}
+
+void LogModel::append(std::vector<LogEntry> &batch) {
+  if (batch.empty()) {
+    return;
+  }
+  auto capacity = ring_.size();
+  auto first = batch.size() > capacity ? batch.size() - capacity : 0;
+  auto count = batch.size() - first;
+  // Evict the oldest rows to make room.
+  if (size_ + count > capacity) {
+    auto evict = size_ + count - capacity;
+    beginRemoveRows(QModelIndex(), 0, static_cast<int>(evict) - 1);
+    head_ = (head_ + evict) % capacity;
+    size_ -= evict;
+    endRemoveRows();
+  }
+  beginInsertRows(QModelIndex(), static_cast<int>(size_),
+                  static_cast<int>(size_ + count) - 1);
+  for (auto i = first; i < batch.size(); ++i) {
+    ring_[(head_ + size_) % capacity] = std::move(batch[i]);
+    ++size_;
+  }
+  endInsertRows();
+}
+
+void LogFilter::setMinLevel(int level) {
+  min_level_ = level;
+  invalidateFilter();
+}
+
+void LogFilter::setWorker(const QString &worker) {
+  worker_ = worker;
+  invalidateFilter();
+}
+
+bool LogFilter::filterAcceptsRow(int row, const QModelIndex &parent) const {
+  auto index = sourceModel()->index(row, 0, parent);
+  if (index.data(LogModel::LEVEL_ROLE).toInt() < min_level_) {
+    return false;
+  }
+  return worker_.isEmpty() ||
+         index.data(LogModel::WORKER_ROLE).toString() == worker_;
+}
+
+LogPanel::LogPanel(QWidget *parent)
+    : QWidget(parent),
+      sink_(std::make_shared<LogPanelSink>(CAPACITY)),
+      model_(new LogModel(CAPACITY, this)),
+      filter_(new LogFilter(this)),
+      level_(new QComboBox(this)),
+      worker_(new QComboBox(this)),
+      view_(new QListView(this)) {
+  level_->addItem("Debug", static_cast<int>(spdlog::level::debug));
+  level_->addItem("Info", static_cast<int>(spdlog::level::info));
+  level_->addItem("Warning", static_cast<int>(spdlog::level::warn));
+  level_->addItem("Error", static_cast<int>(spdlog::level::err));
+  worker_->addItem("All workers", QString());
+
+  filter_->setSourceModel(model_);
+  view_->setModel(filter_);
+  // Rows all have the height of the first one, so scrolling and layout
+  // only touch the visible rows.
+  view_->setUniformItemSizes(true);
+  view_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  view_->setSelectionMode(QAbstractItemView::ExtendedSelection);
+  view_->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
+  auto font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+  font.setPointSize(10);
+  view_->setFont(font);
+
+  auto filters = new QHBoxLayout;
+  filters->addWidget(level_);
+  filters->addWidget(worker_);
+  filters->addStretch();
+  auto layout = new QVBoxLayout(this);
+  layout->setContentsMargins(0, 0, 0, 0);
+  layout->addLayout(filters);
+  layout->addWidget(view_);
+
+  auto changed = QOverload<int>::of(&QComboBox::currentIndexChanged);
+  connect(level_, changed, this, [this](int) {
+    filter_->setMinLevel(level_->currentData().toInt());
+  });
+  connect(worker_, changed, this, [this](int) {
+    filter_->setWorker(worker_->currentData().toString());
+  });
+  connect(&timer_, &QTimer::timeout, this, [this]() { drain(); });
+  timer_.start(BATCH_INTERVAL_MS);
+}
+
+void LogPanel::drain() {
+  sink_->take(batch_);
+  if (batch_.empty()) {
+    return;
+  }
+  for (auto &it : batch_) {
+    if (worker_->findData(it.worker) < 0) {
+      worker_->addItem(it.worker, it.worker);
+    }
+  }
+  auto bar = view_->verticalScrollBar();
+  bool follow = bar->value() == bar->maximum();
+  model_->append(batch_);
+  batch_.clear();
+  if (follow) {
+    view_->scrollToBottom();
+  }
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <QAbstractListModel>
+#include <QComboBox>
+#include <QListView>
+#include <QSortFilterProxyModel>
+#include <QTimer>
+#include <QWidget>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "spdlog/sinks/base_sink.h"
+
+struct LogEntry {
+  spdlog::level::level_enum level = spdlog::level::info;
+  QString worker;
+  QString text;
+};
+
+// Buffers formatted messages from any thread until the panel takes them.
+// Holds at most capacity messages, older ones would be evicted by the
+// panel anyway.
+class LogPanelSink : public spdlog::sinks::base_sink<std::mutex> {
+ public:
+  explicit LogPanelSink(size_t capacity);
+
+  void take(std::vector<LogEntry> &out);
+
+ protected:
+  void sink_it_(const spdlog::details::log_msg &msg) override;
+  void flush_() override {}
+
+ private:
+  const size_t capacity_;
+  std::deque<LogEntry> pending_;
+};
+
+// The last capacity messages in a fixed ring, oldest row first.
+class LogModel : public QAbstractListModel {
+ public:
+  static const int LEVEL_ROLE = Qt::UserRole;
+  static const int WORKER_ROLE = Qt::UserRole + 1;
+
+  LogModel(size_t capacity, QObject *parent);
+
+  int rowCount(const QModelIndex &parent) const override;
+  QVariant data(const QModelIndex &index, int role) const override;
+
+  void append(std::vector<LogEntry> &batch);
+
+ private:
+  std::vector<LogEntry> ring_;
+  size_t head_ = 0;
+  size_t size_ = 0;
+
+  const LogEntry &at(size_t row) const {
+    return ring_[(head_ + row) % ring_.size()];
+  }
+};
+
+class LogFilter : public QSortFilterProxyModel {
+ public:
+  using QSortFilterProxyModel::QSortFilterProxyModel;
+
+  void setMinLevel(int level);
+  // Empty shows every worker.
+  void setWorker(const QString &worker);
+
+ protected:
+  bool filterAcceptsRow(int row, const QModelIndex &parent) const override;
+
+ private:
+  int min_level_ = spdlog::level::debug;
+  QString worker_;
+};
+
+// Log view fed from a sink in batches. Only the visible rows are laid out
+// and the ring keeps memory flat however long the session runs.
+class LogPanel : public QWidget {
+ public:
+  explicit LogPanel(QWidget *parent = nullptr);
+
+  std::shared_ptr<LogPanelSink> sink() const { return sink_; }
+
+ private:
+  const size_t CAPACITY = 20000;
+  const int BATCH_INTERVAL_MS = 100;
+
+  std::shared_ptr<LogPanelSink> sink_;
+  LogModel *model_;
+  LogFilter *filter_;
+  QComboBox *level_;
+  QComboBox *worker_;
+  QListView *view_;
+  QTimer timer_;
+  std::vector<LogEntry> batch_;
+
+  void drain();
+};
@@ -1,27 +1,35 @@
 #include "bark_impl.hpp"
 
-#include "httplib.h"
 #include "spdlog/spdlog.h"
 
 namespace notification {
 
-BarkNotifierImpl::BarkNotifierImpl(std::string bark_id)
-    : bark_id_(std::move(bark_id)) {
+BarkNotifierImpl::BarkNotifierImpl(std::string bark_id,
+                                   const std::string &server,
+                                   const ClientSetup &setup)
+    : bark_id_(std::move(bark_id)), client_(server) {
+  client_.set_keep_alive(true);
+  if (setup) {
+    setup(client_);
+  }
+  client_.set_connection_timeout(std::chrono::seconds(3));
+  client_.set_read_timeout(std::chrono::seconds(5));
   spdlog::info("Bark notifier initialized with bark_id {}", bark_id_);
 }
 
 bool BarkNotifierImpl::notify(const std::string &msg) {
-  httplib::Client client("https://api.day.app");
   httplib::Params params{{"sound", "minuet"}};
   httplib::Headers headers{{"Accept-Encoding", "gzip, deflate"}};
 
-  auto resp = client.Get(("/" + bark_id_ + "/" + msg).c_str(), params, headers);
-  return (resp.error() == httplib::Error::Success);
+  auto resp =
+      client_.Get(("/" + bark_id_ + "/" + msg).c_str(), params, headers);
+  return resp && resp->status == 200;
 }
 
 std::shared_ptr<BarkNotifier> BarkNotifier::makeBarkNotifier(
-    const std::string &bark_id) {
-  return std::make_shared<BarkNotifierImpl>(bark_id);
+    const std::string &bark_id, const std::string &server,
+    ClientSetup setup) {
+  return std::make_shared<BarkNotifierImpl>(bark_id, server, setup);
 }
 
-}  // namespace notification
\ No newline at end of file
+}  // namespace notification
@@ -1,17 +1,21 @@
 #include <string>
 
+#include "httplib.h"
 #include "notification/bark.hpp"
 
 namespace notification {
 
 class BarkNotifierImpl : public BarkNotifier {
  public:
-  explicit BarkNotifierImpl(std::string);
+  BarkNotifierImpl(std::string, const std::string &, const ClientSetup &);
+
+  const char *name() const override { return "bark"; }
 
   bool notify(const std::string &) override;
 
  private:
   std::string bark_id_;
+  httplib::Client client_;
 };
 
-}  // namespace notification
\ No newline at end of file
+}  // namespace notification
@@ -0,0 +1,111 @@
+#include "notifier_impl.hpp"
+
+#include "spdlog/spdlog.h"
+
+namespace notification {
+
+namespace {
+
+// Upper bound on how late a message posted while the thread goes to sleep
+// is picked up; post() signals without taking the lock.
+const std::chrono::milliseconds IDLE_WAIT(100);
+
+}  // namespace
+
+NotifierImpl::NotifierImpl(std::chrono::milliseconds coalesce_window)
+    : coalesce_window_(coalesce_window),
+      queue_(QUEUE_CAPACITY),
+      running_(true),
+      dropped_(0) {
+  thread_ = std::thread([this]() { run(); });
+}
+
+NotifierImpl::~NotifierImpl() { stop(); }
+
+bool NotifierImpl::post(std::string msg) {
+  if (!queue_.push(std::move(msg))) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  cv_.notify_one();
+  return true;
+}
+
+void NotifierImpl::addSink(std::shared_ptr<Sink> sink) {
+  std::lock_guard<std::mutex> lck(mutex_);
+  sinks_.emplace_back(std::move(sink));
+}
+
+void NotifierImpl::stop() {
+  {
+    std::lock_guard<std::mutex> lck(mutex_);
+    running_ = false;
+  }
+  cv_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+    spdlog::info("Notifier stopped, {} coalesced, {} dropped", coalesced_,
+                 dropped_.load(std::memory_order_relaxed));
+  }
+}
+
+void NotifierImpl::run() {
+  std::string msg;
+  while (true) {
+    while (queue_.pop(msg)) {
+      deliver(msg);
+    }
+    std::unique_lock<std::mutex> lck(mutex_);
+    if (!running_) {
+      break;
+    }
+    cv_.wait_for(lck, IDLE_WAIT,
+                 [this]() { return !running_ || !queue_.empty(); });
+  }
+  while (queue_.pop(msg)) {
+    deliver(msg);
+  }
+}
+
+void NotifierImpl::deliver(const std::string &msg) {
+  auto now = std::chrono::steady_clock::now();
+  auto it = last_sent_.find(msg);
+  if (it != last_sent_.end() && now - it->second < coalesce_window_) {
+    ++coalesced_;
+    spdlog::debug("Coalesced notification {}", msg);
+    return;
+  }
+  if (last_sent_.size() >= QUEUE_CAPACITY) {
+    for (auto iter = last_sent_.begin(); iter != last_sent_.end();) {
+      if (now - iter->second >= coalesce_window_) {
+        iter = last_sent_.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+  }
+  last_sent_[msg] = now;
+
+  std::vector<std::shared_ptr<Sink>> sinks;
+  {
+    std::lock_guard<std::mutex> lck(mutex_);
+    sinks = sinks_;
+  }
+  for (auto &sink : sinks) {
+    if (!sink->notify(msg)) {
+      spdlog::warn("Failed to deliver notification via {}", sink->name());
+    }
+  }
+}
+
+std::shared_ptr<Notifier> Notifier::makeNotifier(
+    std::chrono::milliseconds coalesce_window) {
+  return std::make_shared<NotifierImpl>(coalesce_window);
+}
+
+std::shared_ptr<Sink> Sink::makeCallbackSink(
+    std::function<void(const std::string &)> cb) {
+  return std::make_shared<CallbackSink>(std::move(cb));
+}
+
+}  // namespace notification
@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "bounded_queue.hpp"
+#include "notification/notifier.hpp"
+
+namespace notification {
+
+class NotifierImpl : public Notifier {
+ public:
+  explicit NotifierImpl(std::chrono::milliseconds coalesce_window);
+
+  ~NotifierImpl() override;
+
+  bool post(std::string msg) override;
+
+  void addSink(std::shared_ptr<Sink>) override;
+
+  void stop() override;
+
+ private:
+  static const size_t QUEUE_CAPACITY = 64;
+
+  const std::chrono::milliseconds coalesce_window_;
+  BoundedQueue<std::string> queue_;
+  std::atomic<bool> running_;
+  std::atomic<uint64_t> dropped_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<std::shared_ptr<Sink>> sinks_;
+  std::thread thread_;
+
+  // Only touched by the notifier thread.
+  std::unordered_map<std::string, std::chrono::steady_clock::time_point>
+      last_sent_;
+  uint64_t coalesced_ = 0;
+
+  void run();
+  void deliver(const std::string &msg);
+};
+
+class CallbackSink : public Sink {
+ public:
+  explicit CallbackSink(std::function<void(const std::string &)> cb)
+      : cb_(std::move(cb)) {}
+
+  const char *name() const override { return "callback"; }
+
+  bool notify(const std::string &msg) override {
+    cb_(msg);
+    return true;
+  }
+
+ private:
+  std::function<void(const std::string &)> cb_;
+};
+
+}  // namespace notification
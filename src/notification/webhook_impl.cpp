@@ -0,0 +1,41 @@
+#include "webhook_impl.hpp"
+
+#include "nlohmann/json.hpp"
+#include "spdlog/spdlog.h"
+
+namespace notification {
+
+WebhookNotifierImpl::WebhookNotifierImpl(const std::string &host,
+                                         std::string path,
+                                         const ClientSetup &setup)
+    : client_(host), path_(std::move(path)) {
+  client_.set_keep_alive(true);
+  if (setup) {
+    setup(client_);
+  }
+  client_.set_connection_timeout(std::chrono::seconds(3));
+  client_.set_read_timeout(std::chrono::seconds(5));
+  spdlog::info("Webhook notifier initialized with {}{}", host, path_);
+}
+
+bool WebhookNotifierImpl::notify(const std::string &msg) {
+  nlohmann::json body;
+  body["msg"] = msg;
+  auto resp = client_.Post(path_.c_str(), body.dump(), "application/json");
+  return resp && resp->status >= 200 && resp->status < 300;
+}
+
+std::shared_ptr<WebhookNotifier> WebhookNotifier::makeWebhookNotifier(
+    const std::string &url, ClientSetup setup) {
+  // Split "scheme://host[:port]/path" into the client host and the path.
+  auto host_begin = url.find("://");
+  host_begin = host_begin == std::string::npos ? 0 : host_begin + 3;
+  auto path_begin = url.find('/', host_begin);
+  if (path_begin == std::string::npos) {
+    return std::make_shared<WebhookNotifierImpl>(url, "/", setup);
+  }
+  return std::make_shared<WebhookNotifierImpl>(
+      url.substr(0, path_begin), url.substr(path_begin), setup);
+}
+
+}  // namespace notification
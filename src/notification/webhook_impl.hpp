@@ -0,0 +1,23 @@
+#pragma once
+#include <string>
+
+#include "httplib.h"
+#include "notification/webhook.hpp"
+
+namespace notification {
+
+class WebhookNotifierImpl : public WebhookNotifier {
+ public:
+  WebhookNotifierImpl(const std::string &host, std::string path,
+                      const ClientSetup &setup);
+
+  const char *name() const override { return "webhook"; }
+
+  bool notify(const std::string &) override;
+
+ private:
+  httplib::Client client_;
+  std::string path_;
+};
+
+}  // namespace notification
@@ -2,13 +2,11 @@
 
 #include <QInputDialog>
 #include <QMessageBox>
+#include <QtConcurrent>
 #include <fstream>
 #include <regex>
 
 #include "fmt/core.h"
-#include "spdlog/async.h"
-#include "spdlog/async_logger.h"
-#include "spdlog/sinks/qt_sinks.h"
 #include "spdlog/sinks/rotating_file_sink.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
 #include "spdlog/spdlog.h"
@@ -26,6 +24,10 @@ void MainWindow::parseConfig(const std::string& config_file_path) {
     return;
   }
 
+  if (config_json.contains("log_profile") &&
+      config_json["log_profile"] == "lossless") {
+    ddshop::setupLogging(log_sinks_, ddshop::LogProfile::LOSSLESS);
+  }
   if (config_json.contains("cookie")) {
     ui_.editCookie->setText(
         QString::fromStdString(config_json["cookie"].get<std::string>()));
@@ -51,27 +53,56 @@ void MainWindow::parseConfig(const std::string& config_file_path) {
       ui_.comboPay->setCurrentText("Wechat");
     }
   }
+  if (config_json.contains("pool_size") &&
+      config_json["pool_size"].is_number_unsigned()) {
+    pool_size_ = config_json["pool_size"];
+  }
+  if (config_json.contains("base_url")) {
+    base_url_ = config_json["base_url"];
+  }
+  if (config_json.contains("slow_request_ms") &&
+      config_json["slow_request_ms"].is_number_unsigned()) {
+    slow_request_ms_ = config_json["slow_request_ms"];
+  }
+  if (config_json.contains("flight_recorder_dir")) {
+    flight_recorder_dir_ = config_json["flight_recorder_dir"];
+  }
+  if (config_json.contains("record_cassette")) {
+    record_cassette_ = config_json["record_cassette"];
+  }
+  if (config_json.contains("replay_cassette")) {
+    replay_cassette_ = config_json["replay_cassette"];
+    replay_fast_ = config_json.value("replay_fast", false);
+  }
+  if (config_json.contains("hosts_file")) {
+    hosts_file_ = config_json["hosts_file"];
+  }
+  compression_ = config_json.value("compression", compression_);
+  if (config_json.contains("metrics_port")) {
+    metrics_server_ = ddshop::MetricsServer::makeMetricsServer(
+        "127.0.0.1", config_json["metrics_port"]);
+  }
+  if (config_json.contains("webhook_url")) {
+    webhook_url_ = config_json["webhook_url"];
+  }
+  if (config_json.contains("trace_file")) {
+    trace_file_ = config_json["trace_file"];
+  }
+  if (config_json.contains("warmup_seconds") &&
+      config_json["warmup_seconds"].is_number_unsigned()) {
+    warmup_seconds_ = config_json["warmup_seconds"];
+  }
   if (config_json.contains("schedules")) {
     schedules_.clear();
     ui_.listSched->clear();
     for (auto& it : config_json["schedules"]) {
-      if (it["start"].size() != 2 || it["stop"].size() != 2 ||
-          it["start"][0] < 0 || it["start"][0] > 23 || it["stop"][0] < 0 ||
-          it["stop"][0] > 23 || it["start"][1] < 0 || it["start"][1] > 59 ||
-          it["stop"][1] < 0 || it["stop"][1] > 59 ||
-          (it["start"][0] == it["stop"][0] &&
-           it["start"][1] == it["stop"][1])) {
-        spdlog::error("Invalid schedule");
+      ddshop::Schedule tmp;
+      if (!ddshop::parseSchedule(it, tmp)) {
+        spdlog::error("Invalid schedule {}", it.dump());
         continue;
       }
-      ddshop::Schedule tmp;
-      tmp.start_time = std::make_pair(it["start"][0].get<uint64_t>(),
-                                      it["start"][1].get<uint64_t>());
-      tmp.stop_time = std::make_pair(it["stop"][0].get<uint64_t>(),
-                                     it["stop"][1].get<uint64_t>());
-      ui_.listSched->addItem(QString::fromStdString(fmt::format(
-          "{:02d}:{:02d} - {:02d}:{:02d}", tmp.start_time.first,
-          tmp.start_time.second, tmp.stop_time.first, tmp.stop_time.second)));
+      ui_.listSched->addItem(
+          QString::fromStdString(ddshop::describeSchedule(tmp)));
       schedules_.emplace_back(std::move(tmp));
     }
   }
@@ -80,30 +111,36 @@ void MainWindow::parseConfig(const std::string& config_file_path) {
 void MainWindow::btnAddClick() {
   bool ok;
   auto text = QInputDialog::getText(this, "Add schedule",
-                                    "Schedule time ( in format HH:SS-HH:SS )",
+                                    "Schedule time ( in format "
+                                    "HH:MM[:SS]-HH:MM[:SS] )",
                                     QLineEdit::Normal, "", &ok)
                   .toStdString();
   if (ok) {
-    std::regex r(R"(^(\d{2}):(\d{2})\s*\-\s*(\d{2}):(\d{2})$)");
+    std::regex r(R"(^(\d{2}):(\d{2})(?::(\d{2}))?\s*\-\s*)"
+                 R"((\d{2}):(\d{2})(?::(\d{2}))?$)");
     std::smatch match;
-    if (std::regex_search(text, match, r) && match.size() == 5) {
-      ddshop::Schedule tmp{};
-      tmp.start_time.first = std::stoi(match[1].str());
-      tmp.start_time.second = std::stoi(match[2].str());
-      tmp.stop_time.first = std::stoi(match[3].str());
-      tmp.stop_time.second = std::stoi(match[4].str());
-      if (tmp.start_time.first > 23 || tmp.stop_time.first > 23 ||
-          tmp.start_time.second > 59 || tmp.stop_time.second > 59 ||
-          (tmp.start_time.first == tmp.stop_time.first &&
-           tmp.start_time.second == tmp.stop_time.second)) {
+    if (std::regex_search(text, match, r) && match.size() == 7) {
+      auto seconds = [&match](int first) {
+        return std::stoi(match[first].str()) * 3600 +
+               std::stoi(match[first + 1].str()) * 60 +
+               (match[first + 2].matched ? std::stoi(match[first + 2].str())
+                                         : 0);
+      };
+      auto valid = [&match](int first) {
+        return std::stoi(match[first].str()) <= 23 &&
+               std::stoi(match[first + 1].str()) <= 59 &&
+               (!match[first + 2].matched ||
+                std::stoi(match[first + 2].str()) <= 59);
+      };
+      ddshop::Schedule tmp;
+      tmp.start = seconds(1);
+      tmp.stop = seconds(4);
+      if (!valid(1) || !valid(4) || tmp.start == tmp.stop) {
         spdlog::error("Invalid schedule time");
       } else {
-        spdlog::info("Adding schedule {:02d}:{:02d}-{:02d}:{:02d}",
-                     tmp.start_time.first, tmp.start_time.second,
-                     tmp.stop_time.first, tmp.stop_time.second);
-        ui_.listSched->addItem(QString::fromStdString(fmt::format(
-            "{:02d}:{:02d} - {:02d}:{:02d}", tmp.start_time.first,
-            tmp.start_time.second, tmp.stop_time.first, tmp.stop_time.second)));
+        auto description = ddshop::describeSchedule(tmp);
+        spdlog::info("Adding schedule {}", description);
+        ui_.listSched->addItem(QString::fromStdString(description));
         schedules_.emplace_back(std::move(tmp));
       }
     } else {
@@ -120,8 +157,6 @@ void MainWindow::btnDelClick() {
   }
 }
 
-void MainWindow::log(const QString& str) { ui_.textLog->append(str); }
-
 void MainWindow::play(const QString& msg) {
   if (sound_.isFinished()) {
     sound_.play();
@@ -143,15 +178,8 @@ MainWindow::MainWindow(int argc, char** argv)
       "ddshop.log", 30000000, 3);
   file_sink->set_level(spdlog::level::debug);
 
-  auto qt_sink = std::make_shared<spdlog::sinks::qt_sink_mt>(this, "log");
-
-  std::vector<spdlog::sink_ptr> sinks{console_sink, file_sink, qt_sink};
-  spdlog::init_thread_pool(1024, 1);
-  auto logger = std::make_shared<spdlog::async_logger>(
-      "ddshop", sinks.begin(), sinks.end(), spdlog::thread_pool(),
-      spdlog::async_overflow_policy::block);
-  logger->set_level(spdlog::level::debug);
-  spdlog::set_default_logger(logger);
+  log_sinks_ = {console_sink, file_sink, ui_.logPanel->sink()};
+  ddshop::setupLogging(log_sinks_, ddshop::LogProfile::HOT_PATH);
 
   if (argc == 2) {
     parseConfig(argv[1]);
@@ -164,11 +192,20 @@ MainWindow::MainWindow(int argc, char** argv)
   connect(ui_.btnDelete, &QPushButton::clicked, this, &MainWindow::btnDelClick);
   connect(this, &MainWindow::onSuccess, this, &MainWindow::play,
           Qt::QueuedConnection);
+  connect(&login_watcher_, &QFutureWatcher<LoginResult>::finished, this,
+          &MainWindow::loginFinished);
+  connect(&stop_watcher_, &QFutureWatcher<void>::finished, this,
+          &MainWindow::stopFinished);
   show();
 }
 
+MainWindow::~MainWindow() {
+  login_watcher_.waitForFinished();
+  stop_watcher_.waitForFinished();
+}
+
 void MainWindow::btnLoginClick() {
-  if (dispatcher_ != nullptr) {
+  if (dispatcher_ != nullptr || login_watcher_.isRunning()) {
     return;
   }
   if (ui_.editCookie->text().isEmpty()) {
@@ -177,6 +214,15 @@ void MainWindow::btnLoginClick() {
   }
   ddshop::SessionConfig config{};
   config.cookie = ui_.editCookie->text().toStdString();
+  config.pool_size = pool_size_;
+  config.base_url = base_url_;
+  config.slow_request_ms = slow_request_ms_;
+  config.flight_recorder_dir = flight_recorder_dir_;
+  config.record_cassette = record_cassette_;
+  config.replay_cassette = replay_cassette_;
+  config.replay_fast = replay_fast_;
+  config.hosts_file = hosts_file_;
+  config.compression = compression_;
   if (ui_.comboPay->currentText() == "Alipay") {
     config.pay_type = ddshop::PayType::ALIPAY;
   } else if (ui_.comboPay->currentText() == "Wechat") {
@@ -187,37 +233,65 @@ void MainWindow::btnLoginClick() {
   } else if (ui_.comboChannel->currentText() == "Applet") {
     config.channel = ddshop::Channel::APPLET;
   }
-  dispatcher_ = ddshop::Dispatcher::makeDispatcher();
-  if (dispatcher_->initSession(config)) {
-    addresses_.clear();
-    dispatcher_->getSession()->getAddresses(addresses_);
-    if (addresses_.empty()) {
+  ui_.btnLogin->setDisabled(true);
+  ui_.statusbar->showMessage("Logging in...");
+  login_watcher_.setFuture(QtConcurrent::run([config]() {
+    LoginResult result;
+    try {
+      result.dispatcher = ddshop::Dispatcher::makeDispatcher();
+      result.logged_in = result.dispatcher->initSession(config);
+      if (result.logged_in) {
+        result.dispatcher->getSession()->getAddresses(result.addresses);
+      }
+    } catch (const std::exception& e) {
+      spdlog::error("Login failed: {}", e.what());
+      result.logged_in = false;
+    }
+    return result;
+  }));
+}
+
+void MainWindow::loginFinished() {
+  auto result = login_watcher_.result();
+  if (!result.logged_in || result.addresses.empty()) {
+    ui_.btnLogin->setDisabled(false);
+    ui_.statusbar->showMessage("Login failed");
+    if (result.logged_in) {
       QMessageBox::warning(this, "Warning", "No available address found");
     } else {
-      ui_.btnLogin->setDisabled(true);
-      ui_.editCookie->setDisabled(true);
-      ui_.editBarkId->setDisabled(true);
-      ui_.comboChannel->setDisabled(true);
-      ui_.comboPay->setDisabled(true);
+      QMessageBox::warning(this, "Warning", "Login failed, check your cookie");
+    }
+    return;
+  }
+  dispatcher_ = std::move(result.dispatcher);
+  addresses_ = std::move(result.addresses);
 
-      ui_.btnStart->setEnabled(true);
+  ui_.editCookie->setDisabled(true);
+  ui_.editBarkId->setDisabled(true);
+  ui_.comboChannel->setDisabled(true);
+  ui_.comboPay->setDisabled(true);
 
-      if (!ui_.editBarkId->text().isEmpty()) {
-        dispatcher_->initBarkNotifier(ui_.editBarkId->text().toStdString());
-      }
+  ui_.btnStart->setEnabled(true);
+
+  if (!ui_.editBarkId->text().isEmpty()) {
+    dispatcher_->initBarkNotifier(ui_.editBarkId->text().toStdString());
+  }
+  if (!webhook_url_.empty()) {
+    dispatcher_->initWebhookNotifier(webhook_url_);
+  }
+  if (!trace_file_.empty()) {
+    dispatcher_->initTrace(trace_file_);
+  }
 
-      dispatcher_->onSuccess([this](const std::string& msg) {
-        emit(onSuccess(QString::fromStdString(msg)));
-      });
+  dispatcher_->onSuccess([this](const std::string& msg) {
+    emit(onSuccess(QString::fromStdString(msg)));
+  });
 
-      ui_.comboAddress->clear();
-      for (auto& it : addresses_) {
-        ui_.comboAddress->addItem(QString::fromStdString(it.address));
-      }
-    }
-  } else {
-    QMessageBox::warning(this, "Warning", "Login failed, check your cookie");
+  ui_.comboAddress->clear();
+  for (auto& it : addresses_) {
+    ui_.comboAddress->addItem(QString::fromStdString(it.address));
   }
+  ui_.statusbar->showMessage("Logged in");
 }
 
 void MainWindow::btnStartClick() {
@@ -228,6 +302,7 @@ void MainWindow::btnStartClick() {
       if (!schedules_.empty()) {
         dispatcher_->setSchedule(schedules_);
       }
+      dispatcher_->setWarmup(std::chrono::seconds(warmup_seconds_));
 
       dispatcher_->start();
 
@@ -236,14 +311,24 @@ void MainWindow::btnStartClick() {
       ui_.btnDelete->setDisabled(true);
       ui_.listSched->setDisabled(true);
       ui_.btnStart->setText("Stop");
-    } else {
-      dispatcher_->stop();
-
-      ui_.comboAddress->setDisabled(false);
-      ui_.btnAdd->setDisabled(false);
-      ui_.btnDelete->setDisabled(false);
-      ui_.listSched->setDisabled(false);
-      ui_.btnStart->setText("Start");
+      ui_.statusbar->showMessage("Running");
+    } else if (!stop_watcher_.isRunning()) {
+      // Joining the workers may take a moment, the window stays live.
+      ui_.btnStart->setDisabled(true);
+      ui_.statusbar->showMessage("Stopping...");
+      auto dispatcher = dispatcher_;
+      stop_watcher_.setFuture(
+          QtConcurrent::run([dispatcher]() { dispatcher->stop(); }));
     }
   }
 }
+
+void MainWindow::stopFinished() {
+  ui_.comboAddress->setDisabled(false);
+  ui_.btnAdd->setDisabled(false);
+  ui_.btnDelete->setDisabled(false);
+  ui_.listSched->setDisabled(false);
+  ui_.btnStart->setText("Start");
+  ui_.btnStart->setDisabled(false);
+  ui_.statusbar->showMessage("Stopped");
+}
@@ -1,8 +1,11 @@
+#include <QFutureWatcher>
 #include <QMainWindow>
 #include <QSound>
 #include <memory>
 
 #include "ddshop/dispatcher.hpp"
+#include "ddshop/logging.hpp"
+#include "ddshop/metrics_server.hpp"
 #include "ddshop/session.hpp"
 #include "ui_main.h"
 
@@ -11,13 +14,39 @@ class MainWindow : public QMainWindow {
 
  public:
   explicit MainWindow(int argc, char **argv);
+  ~MainWindow() override;
 
  private:
+  // What the login task hands back to the GUI thread.
+  struct LoginResult {
+    std::shared_ptr<ddshop::Dispatcher> dispatcher;
+    std::vector<ddshop::Address> addresses;
+    bool logged_in = false;
+  };
+
   Ui_MainWindow ui_;
   std::vector<ddshop::Address> addresses_;
   std::vector<ddshop::Schedule> schedules_;
+  size_t pool_size_ = ddshop::SessionConfig().pool_size;
+  std::string webhook_url_;
+  std::string trace_file_;
+  std::string base_url_;
+  uint32_t slow_request_ms_ = ddshop::SessionConfig().slow_request_ms;
+  std::string flight_recorder_dir_;
+  std::string record_cassette_;
+  std::string replay_cassette_;
+  bool replay_fast_ = false;
+  std::string hosts_file_;
+  bool compression_ = ddshop::SessionConfig().compression;
+  uint32_t warmup_seconds_ = 0;
   std::shared_ptr<ddshop::Dispatcher> dispatcher_;
+  std::shared_ptr<ddshop::MetricsServer> metrics_server_;
   QSound sound_;
+  std::vector<spdlog::sink_ptr> log_sinks_;
+  // Login and stop block on the network and on joining the workers, so
+  // they run on the thread pool and report back through these.
+  QFutureWatcher<LoginResult> login_watcher_;
+  QFutureWatcher<void> stop_watcher_;
   void parseConfig(const std::string &);
 
  signals:
@@ -29,5 +58,8 @@ class MainWindow : public QMainWindow {
   void btnAddClick();
   void btnDelClick();
   void play(const QString &);
-  void log(const QString &);
+
+ private slots:
+  void loginFinished();
+  void stopFinished();
 };
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "flight_recorder.hpp"
+
+namespace {
+
+struct Entry {
+  std::string worker;
+  ddshop::FlightRecord record;
+  std::string request;
+  std::string response;
+};
+
+class RingFile {
+ public:
+  bool load(const std::string &path) {
+    std::ifstream fin(path, std::ios::binary);
+    if (!fin.read(reinterpret_cast<char *>(&header_), sizeof(header_)) ||
+        memcmp(header_.magic, ddshop::FLIGHT_FILE_MAGIC, 8) != 0 ||
+        header_.version != ddshop::FLIGHT_FILE_VERSION ||
+        header_.header_size != sizeof(header_)) {
+      std::cerr << path << ": not a flight recorder file\n";
+      return false;
+    }
+    data_.resize(header_.capacity);
+    if (!fin.read(&data_[0], data_.size())) {
+      std::cerr << path << ": truncated\n";
+      return false;
+    }
+    return true;
+  }
+
+  // Walks back from head until the bytes that may have been overwritten.
+  void collect(std::vector<Entry> &out) const {
+    auto capacity = header_.capacity;
+    auto newest = std::max(header_.head, header_.reserved);
+    auto limit = newest > capacity ? newest - capacity : 0;
+    auto pos = header_.head;
+    while (pos >= limit + sizeof(ddshop::FlightTrailer)) {
+      ddshop::FlightTrailer trailer;
+      read(pos - sizeof(trailer), &trailer, sizeof(trailer));
+      if (trailer.magic != ddshop::FLIGHT_RECORD_MAGIC ||
+          trailer.size < sizeof(ddshop::FlightRecord) + sizeof(trailer) ||
+          trailer.size > pos - limit) {
+        break;
+      }
+      auto start = pos - trailer.size;
+      Entry entry;
+      read(start, &entry.record, sizeof(entry.record));
+      auto &record = entry.record;
+      if (record.magic != ddshop::FLIGHT_RECORD_MAGIC ||
+          record.size != trailer.size ||
+          sizeof(record) + record.request_len + record.response_len +
+                  sizeof(trailer) >
+              record.size) {
+        break;
+      }
+      entry.worker.assign(header_.worker,
+                          strnlen(header_.worker, sizeof(header_.worker)));
+      entry.request.resize(record.request_len);
+      read(start + sizeof(record), &entry.request[0], record.request_len);
+      entry.response.resize(record.response_len);
+      read(start + sizeof(record) + record.request_len, &entry.response[0],
+           record.response_len);
+      out.emplace_back(std::move(entry));
+      pos = start;
+    }
+  }
+
+ private:
+  ddshop::FlightFileHeader header_{};
+  std::string data_;
+
+  void read(uint64_t pos, void *dst, size_t len) const {
+    auto off = pos % header_.capacity;
+    auto first = std::min<uint64_t>(len, header_.capacity - off);
+    memcpy(dst, data_.data() + off, first);
+    memcpy(static_cast<char *>(dst) + first, data_.data(), len - first);
+  }
+};
+
+std::string formatTime(int64_t wall_ns) {
+  time_t secs = wall_ns / 1000000000;
+  char buf[64];
+  strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", localtime(&secs));
+  char ms[8];
+  snprintf(ms, sizeof(ms), ".%03d",
+           static_cast<int>(wall_ns / 1000000 % 1000));
+  return std::string(buf) + ms;
+}
+
+void printEntry(const Entry &entry, bool bodies) {
+  auto &record = entry.record;
+  auto line_end = entry.request.find('\n');
+  std::cout << formatTime(record.wall_ns) << " " << entry.worker << " "
+            << ddshop::endpointName(
+                   static_cast<ddshop::Endpoint>(record.endpoint))
+            << " " << entry.request.substr(0, line_end) << " -> ";
+  if (record.status >= 0) {
+    std::cout << record.status;
+  } else {
+    std::cout << "error "
+              << httplib::to_string(static_cast<httplib::Error>(record.error));
+  }
+  std::cout << " " << std::fixed << std::setprecision(1)
+            << record.dur_ns / 1e6 << "ms\n";
+  if (!bodies) {
+    return;
+  }
+  if (line_end != std::string::npos && line_end + 1 < entry.request.size()) {
+    std::cout << "  > " << entry.request.substr(line_end + 1) << "\n";
+  }
+  if (!entry.response.empty()) {
+    std::cout << "  < " << entry.response << "\n";
+  }
+}
+
+}  // namespace
+
+// Usage: flight_decode [-m minutes] [-s] ring_file...
+// Prints the recorded requests of all files merged by time. -m keeps the
+// last minutes before the newest record, -s omits the bodies.
+int main(int argc, char **argv) {
+  double minutes = 0;
+  bool bodies = true;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+      minutes = std::stod(argv[++i]);
+    } else if (strcmp(argv[i], "-s") == 0) {
+      bodies = false;
+    } else {
+      paths.emplace_back(argv[i]);
+    }
+  }
+  if (paths.empty()) {
+    std::cerr << "Usage: flight_decode [-m minutes] [-s] ring_file...\n";
+    return 1;
+  }
+
+  std::vector<RingFile> files(paths.size());
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (!files[i].load(paths[i])) {
+      return 1;
+    }
+  }
+
+  std::vector<Entry> entries;
+  for (auto &it : files) {
+    it.collect(entries);
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) {
+              return a.record.wall_ns < b.record.wall_ns;
+            });
+  auto first = entries.begin();
+  if (minutes > 0 && !entries.empty()) {
+    auto since = entries.back().record.wall_ns -
+                 static_cast<int64_t>(minutes * 60 * 1e9);
+    first = std::find_if(entries.begin(), entries.end(),
+                         [since](const Entry &entry) {
+                           return entry.record.wall_ns >= since;
+                         });
+  }
+  for (auto it = first; it != entries.end(); ++it) {
+    printEntry(*it, bodies);
+  }
+  return 0;
+}
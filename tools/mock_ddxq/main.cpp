@@ -0,0 +1,42 @@
+#include <csignal>
+#include <fstream>
+#include <iostream>
+
+#include "mock_ddxq.hpp"
+#include "spdlog/spdlog.h"
+
+namespace {
+
+mock::DdxqMock *server = nullptr;
+
+void signalHandler(int) {
+  if (server) {
+    server->stop();
+  }
+}
+
+}  // namespace
+
+// Usage: mock_ddxq [script.json] [port]
+int main(int argc, char **argv) {
+  mock::Script script;
+  if (argc > 1) {
+    std::ifstream fin(argv[1]);
+    if (!fin.is_open()) {
+      spdlog::error("Cannot open script {}", argv[1]);
+      return 1;
+    }
+    auto json = nlohmann::json::parse(fin, nullptr, false);
+    if (json.is_discarded() || !mock::Script::fromJson(json, script)) {
+      spdlog::error("Invalid script {}", argv[1]);
+      return 1;
+    }
+  }
+  int port = argc > 2 ? std::stoi(argv[2]) : 8080;
+
+  mock::DdxqMock mock(std::move(script));
+  server = &mock;
+  std::signal(SIGINT, signalHandler);
+  std::signal(SIGTERM, signalHandler);
+  return mock.listen("127.0.0.1", port) ? 0 : 1;
+}
@@ -0,0 +1,443 @@
+#include "mock_ddxq.hpp"
+
+#include <ctime>
+
+#include "spdlog/spdlog.h"
+
+namespace mock {
+
+namespace {
+
+const size_t SERVER_THREADS = 32;
+
+const char *errorMessage(int code) {
+  switch (code) {
+    case 5001:
+      return "您选择的商品已售罄";
+    case 5003:
+      return "商品信息有变化，请重新确认";
+    case 5004:
+      return "当前配送时间段已约满，请重新选择配送时段";
+    default:
+      return "系统繁忙";
+  }
+}
+
+// Reads the reserved_time_start from the JSON form field of an order body.
+uint64_t reservedTimeStart(const httplib::Request &req) {
+  if (req.has_param("packages")) {
+    auto packages = nlohmann::json::parse(req.get_param_value("packages"),
+                                          nullptr, false);
+    if (packages.is_array() && !packages.empty()) {
+      return packages[0]
+          .value("reserved_time", nlohmann::json::object())
+          .value("reserved_time_start", 0ULL);
+    }
+  } else if (req.has_param("package_order")) {
+    auto order = nlohmann::json::parse(req.get_param_value("package_order"),
+                                       nullptr, false);
+    if (order.is_object() && order.contains("packages") &&
+        !order["packages"].empty()) {
+      return order["packages"][0].value("reserved_time_start", 0ULL);
+    }
+  }
+  return 0;
+}
+
+nlohmann::json makeProduct(size_t i) {
+  nlohmann::json product;
+  product["id"] = "5f0000" + std::to_string(1000 + i);
+  product["product_name"] = "商品" + std::to_string(i);
+  product["count"] = 1;
+  product["price"] = "9.90";
+  product["total_price"] = "9.90";
+  product["origin_price"] = "9.90";
+  product["total_origin_price"] = "9.90";
+  product["sizes"] = nlohmann::json::array();
+  product["type"] = 1;
+  product["category_path"] = "";
+  return product;
+}
+
+}  // namespace
+
+bool Script::fromJson(const nlohmann::json &json, Script &script) {
+  if (!json.is_object()) {
+    return false;
+  }
+  script.cart_items = json.value("cart_items", script.cart_items);
+  script.unpaid_orders = json.value("unpaid_orders", script.unpaid_orders);
+  script.clock_offset_ms =
+      json.value("clock_offset_ms", script.clock_offset_ms);
+  if (json.contains("latency")) {
+    for (auto &it : json["latency"].items()) {
+      Latency latency;
+      latency.base_ms = it.value().value("base_ms", 0U);
+      latency.jitter_ms = it.value().value("jitter_ms", 0U);
+      script.latency[it.key()] = latency;
+    }
+  }
+  if (json.contains("slots")) {
+    for (auto &it : json["slots"]) {
+      if (!it.contains("start") || !it.contains("end")) {
+        spdlog::error("Slot needs start and end timestamps");
+        return false;
+      }
+      Slot slot;
+      slot.start = it["start"];
+      slot.end = it["end"];
+      slot.open_at_ms = it.value("open_at_ms", 0LL);
+      slot.close_at_ms = it.value("close_at_ms", -1LL);
+      script.slots.emplace_back(slot);
+    }
+  }
+  if (json.contains("errors")) {
+    for (auto &it : json["errors"].items()) {
+      script.errors[it.key()] = it.value().get<std::vector<int>>();
+    }
+  }
+  return true;
+}
+
+DdxqMock::DdxqMock(Script script)
+    : script_(std::move(script)),
+      started_(std::chrono::steady_clock::now()),
+      rand_(std::random_device()()) {
+  server_.set_tcp_nodelay(true);
+  // Keep-alive connections each hold a worker, so size the pool for
+  // several pooled sessions.
+  server_.new_task_queue = []() {
+    return new httplib::ThreadPool(SERVER_THREADS);
+  };
+  route();
+}
+
+DdxqMock::~DdxqMock() { stop(); }
+
+int DdxqMock::start(const std::string &host, int port) {
+  host_ = host;
+  if (port == 0) {
+    port_ = server_.bind_to_any_port(host.c_str());
+  } else {
+    port_ = server_.bind_to_port(host.c_str(), port) ? port : -1;
+  }
+  if (port_ < 0) {
+    spdlog::error("Mock server failed to bind {}:{}", host, port);
+    return -1;
+  }
+  {
+    std::lock_guard<std::mutex> lck(mutex_);
+    started_ = std::chrono::steady_clock::now();
+  }
+  thread_ = std::thread([this]() { server_.listen_after_bind(); });
+  while (!server_.is_running()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  spdlog::info("Mock ddxq server listening on {}", baseUrl());
+  return port_;
+}
+
+bool DdxqMock::listen(const std::string &host, int port) {
+  host_ = host;
+  port_ = port;
+  {
+    std::lock_guard<std::mutex> lck(mutex_);
+    started_ = std::chrono::steady_clock::now();
+  }
+  spdlog::info("Mock ddxq server listening on {}", baseUrl());
+  return server_.listen(host.c_str(), port);
+}
+
+void DdxqMock::stop() {
+  server_.stop();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+std::string DdxqMock::baseUrl() const {
+  return "http://" + host_ + ":" + std::to_string(port_);
+}
+
+void DdxqMock::openSlot(uint64_t start, uint64_t end) {
+  std::lock_guard<std::mutex> lck(mutex_);
+  runtime_slots_.push_back(Slot{start, end, 0, -1});
+}
+
+void DdxqMock::closeSlots() {
+  std::lock_guard<std::mutex> lck(mutex_);
+  runtime_slots_.clear();
+}
+
+void DdxqMock::onSubmit(std::function<void(uint64_t)> cb) {
+  std::lock_guard<std::mutex> lck(mutex_);
+  on_submit_ = std::move(cb);
+}
+
+Counters DdxqMock::counters() const {
+  return Counters{requests_.load(), check_order_.load(),
+                  add_new_order_.load(), orders_placed_.load()};
+}
+
+void DdxqMock::delay(const std::string &path) {
+  ++requests_;
+  std::chrono::milliseconds wait(0);
+  {
+    std::lock_guard<std::mutex> lck(mutex_);
+    auto it = script_.latency.find(path);
+    if (it == script_.latency.end()) {
+      it = script_.latency.find("*");
+    }
+    if (it != script_.latency.end()) {
+      auto jitter = it->second.jitter_ms
+                        ? std::uniform_int_distribution<uint32_t>(
+                              0, it->second.jitter_ms)(rand_)
+                        : 0;
+      wait = std::chrono::milliseconds(it->second.base_ms + jitter);
+    }
+  }
+  if (wait.count()) {
+    std::this_thread::sleep_for(wait);
+  }
+}
+
+int DdxqMock::nextError(const std::string &path) {
+  std::lock_guard<std::mutex> lck(mutex_);
+  auto it = script_.errors.find(path);
+  if (it == script_.errors.end()) {
+    return 0;
+  }
+  auto &pos = error_pos_[path];
+  return pos < it->second.size() ? it->second[pos++] : 0;
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> DdxqMock::openSlots() {
+  std::lock_guard<std::mutex> lck(mutex_);
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::steady_clock::now() - started_)
+                     .count();
+  std::vector<std::pair<uint64_t, uint64_t>> ret;
+  for (auto &it : script_.slots) {
+    if (elapsed >= it.open_at_ms &&
+        (it.close_at_ms < 0 || elapsed < it.close_at_ms)) {
+      ret.emplace_back(it.start, it.end);
+    }
+  }
+  for (auto &it : runtime_slots_) {
+    ret.emplace_back(it.start, it.end);
+  }
+  return ret;
+}
+
+bool DdxqMock::isOpen(uint64_t start) {
+  for (auto &it : openSlots()) {
+    if (it.first == start) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string DdxqMock::httpDate(int64_t offset_ms) {
+  auto now = std::chrono::system_clock::to_time_t(
+      std::chrono::system_clock::now() +
+      std::chrono::milliseconds(offset_ms));
+  struct tm gmt;
+  gmtime_r(&now, &gmt);
+  char buf[32];
+  strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &gmt);
+  return buf;
+}
+
+void DdxqMock::reply(httplib::Response &res, const nlohmann::json &data) {
+  nlohmann::json body;
+  body["success"] = true;
+  body["code"] = 0;
+  body["msg"] = "success";
+  body["data"] = data;
+  res.set_content(body.dump(), "application/json");
+}
+
+void DdxqMock::fail(httplib::Response &res, int code, const std::string &msg) {
+  nlohmann::json body;
+  body["success"] = false;
+  body["code"] = code;
+  body["msg"] = msg;
+  body["data"] = nullptr;
+  res.set_content(body.dump(), "application/json");
+}
+
+void DdxqMock::route() {
+  // Stamped as the response goes out, like a real server does.
+  server_.set_post_routing_handler(
+      [this](const httplib::Request &, httplib::Response &res) {
+        res.set_header("Date", httpDate(script_.clock_offset_ms));
+      });
+  server_.Get("/api/v1/user/detail/",
+              [this](const httplib::Request &req, httplib::Response &res) {
+                delay(req.path);
+                nlohmann::json data;
+                data["user_info"]["id"] = "5e0000000000000000000001";
+                data["user_info"]["name"] = "mock";
+                reply(res, data);
+              });
+
+  server_.Get("/api/v1/user/address/",
+              [this](const httplib::Request &req, httplib::Response &res) {
+                delay(req.path);
+                nlohmann::json address;
+                address["id"] = "5e0000000000000000000002";
+                address["city_number"] = "0101";
+                address["location"]["location"] = {121.4737, 31.2304};
+                address["location"]["address"] = "上海市黄浦区";
+                address["location"]["name"] = "人民广场";
+                address["addr_detail"] = "1号";
+                address["user_name"] = "mock";
+                address["mobile"] = "13800000000";
+                address["station_id"] = "5b8a1f56c0a1ea3d458b456b";
+                nlohmann::json data;
+                data["valid_address"] = {address};
+                reply(res, data);
+              });
+
+  server_.Get("/cart/allCheck",
+              [this](const httplib::Request &req, httplib::Response &res) {
+                delay(req.path);
+                reply(res, nlohmann::json::object());
+              });
+
+  server_.Get("/cart/index", [this](const httplib::Request &req,
+                                    httplib::Response &res) {
+    delay(req.path);
+    if (auto code = nextError(req.path)) {
+      fail(res, code, errorMessage(code));
+      return;
+    }
+    size_t items;
+    {
+      std::lock_guard<std::mutex> lck(mutex_);
+      items = script_.cart_items;
+    }
+    nlohmann::json package;
+    package["products"] = nlohmann::json::array();
+    for (size_t i = 0; i < items; ++i) {
+      package["products"].emplace_back(makeProduct(i));
+    }
+    auto total = std::to_string(items * 990 / 100) + "." +
+                 std::to_string(items * 990 % 100 / 10) + "0";
+    package["package_type"] = 1;
+    package["package_id"] = 1;
+    package["total_money"] = total;
+    package["total_origin_money"] = total;
+    package["goods_real_money"] = total;
+    package["total_count"] = items;
+    package["cart_count"] = items;
+    package["is_presale"] = 0;
+    nlohmann::json data;
+    if (items) {
+      data["new_order_product_list"] = {package};
+    } else {
+      data["new_order_product_list"] = nlohmann::json::array();
+    }
+    data["parent_order_info"]["parent_order_sign"] = "mock-parent-order-sign";
+    reply(res, data);
+  });
+
+  server_.Post("/order/getMultiReserveTime", [this](const httplib::Request &req,
+                                                    httplib::Response &res) {
+    delay(req.path);
+    if (auto code = nextError(req.path)) {
+      fail(res, code, errorMessage(code));
+      return;
+    }
+    nlohmann::json times = nlohmann::json::array();
+    for (auto &it : openSlots()) {
+      nlohmann::json slot;
+      slot["type"] = 1;
+      slot["start_timestamp"] = it.first;
+      slot["end_timestamp"] = it.second;
+      slot["disableType"] = 0;
+      slot["disableMsg"] = "";
+      slot["fullFlag"] = false;
+      times.emplace_back(std::move(slot));
+    }
+    nlohmann::json day;
+    day["times"] = std::move(times);
+    nlohmann::json entry;
+    entry["time"] = {day};
+    entry["station_id"] = "5b8a1f56c0a1ea3d458b456b";
+    reply(res, nlohmann::json::array({entry}));
+  });
+
+  server_.Post("/order/checkOrder", [this](const httplib::Request &req,
+                                           httplib::Response &res) {
+    ++check_order_;
+    delay(req.path);
+    if (auto code = nextError(req.path)) {
+      fail(res, code, errorMessage(code));
+      return;
+    }
+    if (!isOpen(reservedTimeStart(req))) {
+      fail(res, 5004, errorMessage(5004));
+      return;
+    }
+    nlohmann::json order;
+    order["total_money"] = "29.70";
+    order["freight_discount_money"] = "0.00";
+    order["freight_money"] = "0.00";
+    order["freights"] = {{{"freight", {{"freight_real_money", "0.00"}}}}};
+    order["default_coupon"]["_id"] = "";
+    nlohmann::json data;
+    data["order"] = order;
+    reply(res, data);
+  });
+
+  server_.Post("/order/addNewOrder", [this](const httplib::Request &req,
+                                            httplib::Response &res) {
+    ++add_new_order_;
+    auto reserved_time = reservedTimeStart(req);
+    std::function<void(uint64_t)> on_submit;
+    {
+      std::lock_guard<std::mutex> lck(mutex_);
+      on_submit = on_submit_;
+    }
+    if (on_submit) {
+      on_submit(reserved_time);
+    }
+    delay(req.path);
+    if (auto code = nextError(req.path)) {
+      fail(res, code, errorMessage(code));
+      return;
+    }
+    if (!isOpen(reserved_time)) {
+      fail(res, 5004, errorMessage(5004));
+      return;
+    }
+    auto number = ++orders_placed_;
+    nlohmann::json data;
+    data["pay_url"] = "";
+    data["order_number"] = "22041600000" + std::to_string(number);
+    reply(res, data);
+  });
+
+  server_.Post("/order/notPayList",
+               [this](const httplib::Request &req, httplib::Response &res) {
+                 delay(req.path);
+                 size_t count;
+                 {
+                   std::lock_guard<std::mutex> lck(mutex_);
+                   count = script_.unpaid_orders;
+                 }
+                 count += orders_placed_.load();
+                 nlohmann::json data;
+                 data["order_list"] = nlohmann::json::array();
+                 for (size_t i = 0; i < count; ++i) {
+                   data["order_list"].push_back(
+                       {{"order_number", "22041600000" + std::to_string(i)},
+                        {"status", 1}});
+                 }
+                 reply(res, data);
+               });
+}
+
+}  // namespace mock
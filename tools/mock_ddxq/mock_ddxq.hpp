@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "httplib.h"
+#include "nlohmann/json.hpp"
+
+namespace mock {
+
+struct Latency {
+  uint32_t base_ms = 0;
+  uint32_t jitter_ms = 0;
+};
+
+// A delivery slot and when it is offered, in ms since start(). A negative
+// close_at_ms keeps it open.
+struct Slot {
+  uint64_t start;
+  uint64_t end;
+  int64_t open_at_ms = 0;
+  int64_t close_at_ms = -1;
+};
+
+struct Script {
+  size_t cart_items = 3;
+  size_t unpaid_orders = 0;
+  // How far the Date header of every response runs ahead of the local
+  // clock, to stand in for a skewed client.
+  int64_t clock_offset_ms = 0;
+  // Keyed by path, "*" applies to every path without its own entry.
+  std::map<std::string, Latency> latency;
+  std::vector<Slot> slots;
+  // Failure codes (5001, 5003, 5004, ...) returned by successive calls to
+  // a path before it starts succeeding.
+  std::map<std::string, std::vector<int>> errors;
+
+  static bool fromJson(const nlohmann::json &, Script &);
+};
+
+struct Counters {
+  uint64_t requests;
+  uint64_t check_order;
+  uint64_t add_new_order;
+  uint64_t orders_placed;
+};
+
+// Stand-in for the maicai and sunquan ddxq API hosts, serving both on one
+// port so a Session with SessionConfig::base_url can run against it.
+class DdxqMock {
+ public:
+  explicit DdxqMock(Script script);
+
+  ~DdxqMock();
+
+  // Serves on a background thread. port 0 picks a free port. Returns the
+  // bound port, or -1 on failure.
+  int start(const std::string &host = "127.0.0.1", int port = 0);
+
+  void stop();
+
+  // Blocks in the calling thread until stop().
+  bool listen(const std::string &host, int port);
+
+  std::string baseUrl() const;
+
+  // Offers a slot right away, until closeSlots().
+  void openSlot(uint64_t start, uint64_t end);
+
+  void closeSlots();
+
+  // Called on the server thread when addNewOrder arrives, before latency is
+  // applied, with the reserved_time_start of the order.
+  void onSubmit(std::function<void(uint64_t)>);
+
+  Counters counters() const;
+
+ private:
+  httplib::Server server_;
+  std::thread thread_;
+  std::string host_;
+  int port_ = -1;
+
+  mutable std::mutex mutex_;
+  Script script_;
+  std::map<std::string, size_t> error_pos_;
+  std::vector<Slot> runtime_slots_;
+  std::chrono::steady_clock::time_point started_;
+  std::function<void(uint64_t)> on_submit_;
+  std::mt19937 rand_;
+
+  std::atomic<uint64_t> requests_{0};
+  std::atomic<uint64_t> check_order_{0};
+  std::atomic<uint64_t> add_new_order_{0};
+  std::atomic<uint64_t> orders_placed_{0};
+
+  void route();
+  void delay(const std::string &path);
+  int nextError(const std::string &path);
+  std::vector<std::pair<uint64_t, uint64_t>> openSlots();
+  bool isOpen(uint64_t start);
+
+  static std::string httpDate(int64_t offset_ms);
+  static void reply(httplib::Response &res, const nlohmann::json &data);
+  static void fail(httplib::Response &res, int code, const std::string &msg);
+};
+
+}  // namespace mock